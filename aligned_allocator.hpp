@@ -13,14 +13,19 @@
 #include <vector>
 #include <iostream>
 #include <immintrin.h>
+#include "numa.hpp"
+#include "pages.hpp"
 
 /**
  * Allocator for aligned data.
+ * Placement decides where the pages of a new allocation go on NUMA machines, see numa.hpp.
+ * Pages decides whether large allocations are backed by huge pages, see pages.hpp.
  *
  * Modified from the Mallocator from Stephan T. Lavavej.
  * <http://blogs.msdn.com/b/vcblog/archive/2008/08/28/the-mallocator.aspx>
  */
-template <typename T, std::size_t Alignment>
+template <typename T, std::size_t Alignment, typename Placement = sal::numa::default_placement,
+          typename Pages = sal::pages::small_pages>
 class aligned_allocator
 {
 public:
@@ -56,7 +61,7 @@ public:
     template <typename U>
     struct rebind
     {
-        typedef aligned_allocator<U, Alignment> other;
+        typedef aligned_allocator<U, Alignment, Placement, Pages> other;
     } ;
 
     bool operator!=(const aligned_allocator& other) const
@@ -91,7 +96,7 @@ public:
 
     aligned_allocator(const aligned_allocator&) { }
 
-    template <typename U> aligned_allocator(const aligned_allocator<U, Alignment>&) { }
+    template <typename U> aligned_allocator(const aligned_allocator<U, Alignment, Placement, Pages>&) { }
 
     ~aligned_allocator() { }
 
@@ -119,7 +124,7 @@ public:
         }
 
         // Mallocator wraps malloc().
-        void * const pv = _mm_malloc(n * sizeof(T), Alignment);
+        void * const pv = Pages::allocate(n * sizeof(T), Alignment < Placement::alignment ? Placement::alignment : Alignment);
 
         // Allocators should throw std::bad_alloc in the case of memory allocation failure.
         if (pv == NULL)
@@ -128,12 +133,14 @@ public:
             //std::abort();
         }
 
+        Placement::place(pv, n * sizeof(T));
+
         return static_cast<T *>(pv);
     }
 
-    void deallocate(T * const p, const std::size_t) const
+    void deallocate(T * const p, const std::size_t n) const
     {
-        _mm_free(p);
+        Pages::deallocate(p, n * sizeof(T));
     }
 
 
@@ -157,7 +164,8 @@ private:
 };
 
 
-template<typename T, size_t Align = sizeof(T)>
-using aligned_vector = std::vector<T, aligned_allocator<T, Align>>;
+template<typename T, size_t Align = sizeof(T), typename Placement = sal::numa::default_placement,
+         typename Pages = sal::pages::small_pages>
+using aligned_vector = std::vector<T, aligned_allocator<T, Align, Placement, Pages>>;
 
 #endif //TEST_HEAP_ALIGNED_ALLOCATOR_HPP
@@ -0,0 +1,320 @@
+//
+// Handles of sorts and merges running in the background on the scheduler of their invoker.
+//
+
+#ifndef SAL_ASYNC_HPP
+#define SAL_ASYNC_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#ifdef SAL_NO_TBB
+#include "thread_pool.hpp"
+#else
+#include <tbb/tbb.h>
+#endif
+
+namespace sal { namespace async {
+
+// Result of an operation cancelled before its last phase, the data is left partially processed
+class cancelled_error : public std::runtime_error {
+public:
+    cancelled_error() : std::runtime_error("sal::async: operation cancelled") { }
+};
+
+class handle;
+
+namespace internal {
+
+using cancel_flag = std::atomic<bool>;
+
+// Queues a function on a scheduler and returns without waiting for it
+using task_queue = std::function<void(std::function<void()>)>;
+
+// Queue of the invoker's own scheduler, for invokers with an enqueue(f) such as pool_invoker
+template<typename Invoker>
+auto queue_of(const Invoker& invoker, int) -> decltype(Invoker(invoker).enqueue(std::function<void()>()), task_queue())
+{
+    return [invoker](std::function<void()> f) {
+        Invoker copy = invoker;
+        copy.enqueue(std::move(f));
+    };
+}
+
+#ifndef SAL_NO_TBB
+// The TBB arena of the calling thread for the others; TBB calls f as const
+template<typename Invoker>
+task_queue queue_of(const Invoker&, long)
+{
+    return [](std::function<void()> f) { tbb::this_task_arena::enqueue(std::move(f)); };
+}
+#else
+// The pool of the calling worker or the default pool for the others
+template<typename Invoker>
+task_queue queue_of(const Invoker&, long)
+{
+    return queue_of(utils::pool_invoker(), 0);
+}
+#endif
+
+// Scheduler of the phases and continuations of an operation on invoker, so none of them blocks a thread of another scheduler
+template<typename Invoker>
+task_queue queue_of(const Invoker& invoker)
+{
+    return queue_of(invoker, 0);
+}
+
+// Shared by a handle and the tasks of its operation
+class state {
+public:
+    explicit state(task_queue queue, std::shared_ptr<cancel_flag> cancel = std::make_shared<cancel_flag>(false))
+            : queue_(std::move(queue)), cancel_(std::move(cancel)), upstream_(nullptr), done_(false) { }
+
+    const task_queue& queue() const { return queue_; }
+
+    bool cancel_requested() const
+    {
+        if (cancel_->load(std::memory_order_relaxed))
+            return true;
+
+        const cancel_flag* upstream = upstream_.load(std::memory_order_acquire);
+        return upstream && upstream->load(std::memory_order_relaxed);
+    }
+
+    void cancel() { cancel_->store(true, std::memory_order_relaxed); }
+
+    const std::shared_ptr<cancel_flag>& flag() const { return cancel_; }
+
+    // An operation started by a step of a chain is cancelled with the chain as well
+    void follow(const std::shared_ptr<cancel_flag>& upstream)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        upstream_owner_ = upstream;
+        upstream_.store(upstream.get(), std::memory_order_release);
+    }
+
+    void finish(std::exception_ptr error)
+    {
+        std::vector<std::function<void()>> continuations;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = error;
+            done_ = true;
+            continuations.swap(continuations_);
+        }
+        done_cv_.notify_all();
+
+        for (auto& continuation : continuations)
+            continuation();
+    }
+
+    // Calls f once the operation is done, right away when it already is
+    void on_done(std::function<void()> f)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!done_) {
+                continuations_.push_back(std::move(f));
+                return;
+            }
+        }
+        f();
+    }
+
+    bool done() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return done_;
+    }
+
+    void wait() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this] { return done_; });
+    }
+
+    std::exception_ptr error() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return error_;
+    }
+
+private:
+    task_queue queue_;
+    std::shared_ptr<cancel_flag> cancel_;
+    std::shared_ptr<cancel_flag> upstream_owner_;
+    std::atomic<const cancel_flag*> upstream_;
+
+    mutable std::mutex mutex_;
+    mutable std::condition_variable done_cv_;
+    bool done_;
+    std::exception_ptr error_;
+    std::vector<std::function<void()>> continuations_;
+};
+
+// Queues f on the scheduler of the operation of s and returns without waiting for it
+template<typename F>
+void spawn(const std::shared_ptr<state>& s, F f)
+{
+    s->queue()(std::function<void()>(std::move(f)));
+}
+
+/**
+ * Runs phase(0), phase(1), ... as separate scheduler tasks until one returns false. Between two
+ * phases no task of the operation is queued or running, a cancelled operation ends there with
+ * cancelled_error.
+ */
+template<typename Phase>
+void run_phases(std::shared_ptr<state> s, std::shared_ptr<Phase> phase, std::size_t k)
+{
+    spawn(s, [s, phase, k] {
+        if (s->cancel_requested()) {
+            s->finish(std::make_exception_ptr(cancelled_error()));
+            return;
+        }
+
+        bool more = false;
+        try {
+            more = (*phase)(k);
+        } catch (...) {
+            s->finish(std::current_exception());
+            return;
+        }
+
+        if (more)
+            run_phases(s, phase, k + 1);
+        else
+            s->finish(nullptr);
+    });
+}
+
+template<typename Phase>
+handle start(Phase phase, task_queue queue);
+
+}
+
+/**
+ * Future of an asynchronous sort or merge. Waiting is only needed to collect the result; then()
+ * and on_complete() queue follow-up work on the scheduler when the operation is done, so no
+ * thread blocks for it. Handles chained by then() share one cancellation: cancel() on any of them
+ * stops the chain at its next phase boundary.
+ */
+class handle {
+public:
+    handle() { }
+
+    bool valid() const { return static_cast<bool>(state_); }
+
+    bool ready() const { return state_->done(); }
+
+    void wait() const { state_->wait(); }
+
+    // Waits and rethrows the exception of the operation, cancelled_error when it was cancelled
+    void get() const
+    {
+        state_->wait();
+        std::exception_ptr error = state_->error();
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    void cancel() const { state_->cancel(); }
+
+    // Queues f(std::exception_ptr) when the operation is done, with nullptr after success
+    template<typename F>
+    void on_complete(F f) const
+    {
+        std::shared_ptr<internal::state> s = state_;
+        s->on_done([s, f] {
+            internal::spawn(s, [s, f] {
+                F callback = f;
+                callback(s->error());
+            });
+        });
+    }
+
+    /**
+     * Queues f() after the operation succeeded and returns the handle of f. When f returns a
+     * handle, e.g. of a merge it starts, the returned handle completes with that operation. A
+     * failed or cancelled operation skips f and passes its exception on.
+     */
+    template<typename F>
+    handle then(F f) const;
+
+private:
+    explicit handle(std::shared_ptr<internal::state> s) : state_(std::move(s)) { }
+
+    template<typename F>
+    static typename std::enable_if<std::is_void<typename std::result_of<F()>::type>::value>::type
+    _chain(const std::shared_ptr<internal::state>& next, F f)
+    {
+        f();
+        next->finish(nullptr);
+    }
+
+    template<typename F>
+    static typename std::enable_if<std::is_same<typename std::result_of<F()>::type, handle>::value>::type
+    _chain(const std::shared_ptr<internal::state>& next, F f)
+    {
+        std::shared_ptr<internal::state> inner = f().state_;
+        inner->follow(next->flag());
+        inner->on_done([inner, next] { next->finish(inner->error()); });
+    }
+
+    template<typename Phase>
+    friend handle internal::start(Phase phase, internal::task_queue queue);
+
+    std::shared_ptr<internal::state> state_;
+};
+
+template<typename F>
+handle handle::then(F f) const
+{
+    std::shared_ptr<internal::state> previous = state_;
+    std::shared_ptr<internal::state> next = std::make_shared<internal::state>(previous->queue(), previous->flag());
+
+    previous->on_done([previous, next, f] {
+        internal::spawn(next, [previous, next, f] {
+            std::exception_ptr error = previous->error();
+            if (!error && next->cancel_requested())
+                error = std::make_exception_ptr(cancelled_error());
+
+            if (error) {
+                next->finish(error);
+                return;
+            }
+
+            try {
+                _chain(next, f);
+            } catch (...) {
+                next->finish(std::current_exception());
+            }
+        });
+    });
+
+    return handle(next);
+}
+
+namespace internal {
+
+// Starts an operation made of phases on queue, see run_phases()
+template<typename Phase>
+handle start(Phase phase, task_queue queue)
+{
+    std::shared_ptr<state> s = std::make_shared<state>(std::move(queue));
+    run_phases(s, std::make_shared<Phase>(std::move(phase)), 0);
+    return handle(s);
+}
+
+}
+
+}}
+
+#endif //SAL_ASYNC_HPP
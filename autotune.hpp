@@ -0,0 +1,122 @@
+//
+// Calibration of the tuned sizes by timing the sorter and merger on the running host.
+//
+
+#ifndef SAL_AUTOTUNE_HPP
+#define SAL_AUTOTUNE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <type_traits>
+#include <vector>
+#include "sort.hpp"
+#include "tuning.hpp"
+
+namespace sal { namespace tuning {
+
+namespace internal {
+
+// Best of reps runs of f in seconds, every run starts from a fresh copy of input in work
+template<typename T, typename F>
+double best_time(const std::vector<T>& input, std::vector<T>& work, int reps, F f)
+{
+    double best = 0;
+    for (int rep = 0; rep < reps; ++rep) {
+        std::copy(input.begin(), input.end(), work.begin());
+
+        auto start = std::chrono::steady_clock::now();
+        f();
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (rep == 0 || time < best)
+            best = time;
+    }
+
+    return best;
+}
+
+}
+
+/**
+ * Times sorts and merges of random keys over a range of leaf sizes, merge block sizes and
+ * parallel cutoffs around the cache heuristic, then makes the fastest of each the values of
+ * T and Merger for this process and the tuning file. Takes a few seconds; run once per host,
+ * e.g. at installation, rather than before every sort. Returns the chosen values.
+ */
+template<typename T, typename Merger = merge::auto_merger>
+tuned_values calibrate(int reps = 2)
+{
+    static_assert(std::is_arithmetic<T>::value, "calibration generates arithmetic keys only");
+
+    using tuned = sort::sorter<T, utils::parallel_invoker, sort::tuned_block_size, merge::tuned_merger_settings<T, Merger>>;
+    using block_merger = merge::merger<T, utils::parallel_invoker, Merger, merge::tuned_block_partition<T, Merger>>;
+    using path_merger = merge::merger<T, utils::parallel_invoker, Merger, merge::tuned_merge_path_partition<T, Merger>>;
+
+    const cache_info& caches = host_caches();
+    const size_t l2_elements = internal::floor_pow2(caches.l2 / sizeof(T));
+    const size_t n = std::max<size_t>(1 << 18, 8 * l2_elements);
+
+    std::vector<T> input(n), work(n), output(n);
+    std::mt19937_64 rng(n);
+    for (auto& x : input)
+        x = static_cast<T>(rng());
+
+    tuned_slot& current = slot<T, Merger>();
+    tuned_values values = heuristic_values(sizeof(T));
+    double best;
+
+    best = 0;
+    for (size_t divider = 16; divider >= 2; divider /= 2) {
+        tuned_values candidate = values;
+        candidate.leaf_size = internal::clamp(l2_elements / divider, min_block_size, max_block_size);
+        current.set(candidate);
+
+        double time = internal::best_time(input, work, reps, [&] { tuned::merge_sort(work.begin(), work.end()); });
+        if (divider == 16 || time < best) {
+            best = time;
+            values.leaf_size = candidate.leaf_size;
+        }
+    }
+
+    //the merges below take two sorted halves
+    std::sort(input.begin(), input.begin() + n / 2);
+    std::sort(input.begin() + n / 2, input.end());
+
+    best = 0;
+    for (size_t divider = 16; divider >= 1; divider /= 2) {
+        tuned_values candidate = values;
+        candidate.merge_block_size = internal::clamp(l2_elements / divider, min_block_size, max_block_size);
+        current.set(candidate);
+
+        double time = internal::best_time(input, work, reps, [&] {
+            block_merger::merge(work.begin(), work.begin() + n / 2, work.end(), output.begin());
+        });
+        if (divider == 16 || time < best) {
+            best = time;
+            values.merge_block_size = candidate.merge_block_size;
+        }
+    }
+
+    best = 0;
+    for (size_t factor = 1; factor <= max_cutoff_blocks; factor *= 2) {
+        tuned_values candidate = values;
+        candidate.parallel_cutoff = factor * values.merge_block_size;
+        current.set(candidate);
+
+        double time = internal::best_time(input, work, reps, [&] {
+            path_merger::merge(work.begin(), work.begin() + n / 2, work.end(), output.begin());
+        });
+        if (factor == 1 || time < best) {
+            best = time;
+            values.parallel_cutoff = candidate.parallel_cutoff;
+        }
+    }
+
+    current.set(values);
+    registry::instance().store(key<T, Merger>(), values);
+    return values;
+}
+
+}}
+
+#endif //SAL_AUTOTUNE_HPP
@@ -0,0 +1,446 @@
+//
+// Benchmark of the sorters and merger policies against std::sort, std::stable_sort and
+// tbb::parallel_sort over input distributions, element types, sizes and thread counts.
+// Results are written as JSON, progress goes to stderr. Run with --help for the options.
+//
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <tbb/tbb.h>
+#include "aligned_allocator.hpp"
+#include "sort.hpp"
+#include "tuning.hpp"
+
+using namespace sal::merge;
+
+namespace {
+
+using pair_key = std::pair<int32_t, int32_t>;
+
+// Conversions of random bits and of order-preserving ranks to every benchmarked element type
+template<typename T>
+struct key_traits;
+
+template<>
+struct key_traits<int32_t> {
+    static const char* name() { return "int32"; }
+    static int32_t from_bits(uint64_t bits) { return static_cast<int32_t>(bits); }
+    static int32_t from_rank(uint64_t rank) { return static_cast<int32_t>(rank); }
+};
+
+template<>
+struct key_traits<int64_t> {
+    static const char* name() { return "int64"; }
+    static int64_t from_bits(uint64_t bits) { return static_cast<int64_t>(bits); }
+    static int64_t from_rank(uint64_t rank) { return static_cast<int64_t>(rank); }
+};
+
+template<>
+struct key_traits<double> {
+    static const char* name() { return "double"; }
+    static double from_bits(uint64_t bits) { return std::ldexp(static_cast<double>(bits >> 11), -53) * 2 - 1; }
+    static double from_rank(uint64_t rank) { return static_cast<double>(rank); }
+};
+
+template<>
+struct key_traits<pair_key> {
+    static const char* name() { return "pair"; }
+    static pair_key from_bits(uint64_t bits) { return pair_key(static_cast<int32_t>(bits >> 32), static_cast<int32_t>(bits)); }
+    static pair_key from_rank(uint64_t rank) { return pair_key(static_cast<int32_t>(rank), static_cast<int32_t>(rank & 7)); }
+};
+
+const char* const input_names[] = {
+    "uniform", "sorted", "reversed", "organ_pipe", "few_unique", "zipf", "sawtooth", "almost_sorted"
+};
+
+/**
+ * Fills data[0, n) with the named distribution. Blocks are generated in parallel, each from its
+ * own generator seeded by the block index, so the input only depends on the name, n and seed.
+ * few_unique has 16 distinct keys, zipf draws from up to 2^20 keys with exponent 1, sawtooth is
+ * 16 ascending runs and almost_sorted replaces 10% of a sorted sequence with random keys.
+ */
+template<typename T>
+void generate(const std::string& input, T* data, size_t n, uint64_t seed)
+{
+    using traits = key_traits<T>;
+    const size_t block = 1 << 16;
+
+    std::vector<double> zipf_cdf;
+    size_t zipf_keys = 1;
+    if (input == "zipf") {
+        while (zipf_keys * 2 <= std::min<size_t>(n, 1 << 20))
+            zipf_keys *= 2;
+
+        zipf_cdf.resize(zipf_keys);
+        double sum = 0;
+        for (size_t r = 0; r < zipf_keys; ++r)
+            zipf_cdf[r] = sum += 1.0 / (r + 1);
+        for (auto& c : zipf_cdf)
+            c /= sum;
+    }
+
+    const size_t tooth = std::max<size_t>(1, n / 16);
+
+    tbb::parallel_for(size_t(0), (n + block - 1) / block, [&](size_t b) {
+        std::mt19937_64 rng(seed * 0x9E3779B97F4A7C15ULL + b);
+        std::uniform_real_distribution<double> unit(0, 1);
+
+        for (size_t i = b * block; i < std::min(n, (b + 1) * block); ++i) {
+            if (input == "uniform") {
+                data[i] = traits::from_bits(rng());
+            } else if (input == "sorted") {
+                data[i] = traits::from_rank(i);
+            } else if (input == "reversed") {
+                data[i] = traits::from_rank(n - 1 - i);
+            } else if (input == "organ_pipe") {
+                data[i] = traits::from_rank(i < n / 2 ? i : n - 1 - i);
+            } else if (input == "few_unique") {
+                data[i] = traits::from_rank(rng() % 16);
+            } else if (input == "zipf") {
+                //frequent ranks are scattered over the key range by an odd multiplier
+                const size_t rank = std::upper_bound(zipf_cdf.begin(), zipf_cdf.end() - 1, unit(rng)) - zipf_cdf.begin();
+                data[i] = traits::from_rank(rank * 2654435761ULL % zipf_keys);
+            } else if (input == "sawtooth") {
+                data[i] = traits::from_rank(i % tooth);
+            } else {
+                data[i] = traits::from_rank(unit(rng) < 0.1 ? rng() % n : i);
+            }
+        }
+    });
+}
+
+template<typename T>
+struct algorithm {
+    std::string name;
+    bool parallel;
+    std::function<void(T*, T*)> sort;
+};
+
+template<typename Merger>
+const char* merger_name();
+
+template<> const char* merger_name<default_merger>() { return "default_merger"; }
+template<> const char* merger_name<simd_merger>() { return "simd_merger"; }
+template<> const char* merger_name<auto_merger>() { return "auto_merger"; }
+
+template<typename T, typename Merger>
+void add_merge_sorts(std::vector<algorithm<T>>& list)
+{
+    const std::string merger = merger_name<Merger>();
+
+    list.push_back({ "sal::merge_sort<" + merger + ",auto_block_partition>", true, [](T* first, T* last) {
+        sal::sort::sorter<T, parallel_invoker, 8192, merger_settings<Merger, auto_block_partition>>::merge_sort(first, last);
+    } });
+    list.push_back({ "sal::merge_sort<" + merger + ",merge_path_partition>", true, [](T* first, T* last) {
+        sal::sort::sorter<T, parallel_invoker, 8192, merger_settings<Merger, merge_path_partition<>>>::merge_sort(first, last);
+    } });
+    list.push_back({ "sal::merge_sort<" + merger + ",tuned_block_partition>", true, [](T* first, T* last) {
+        sal::sort::sorter<T, parallel_invoker, sal::sort::tuned_block_size, tuned_merger_settings<T, Merger>>::merge_sort(first, last);
+    } });
+    list.push_back({ "sal::merge_sort<" + merger + ",serial>", false, [](T* first, T* last) {
+        sal::sort::sorter<T, serial_invoker, 8192, merger_settings<Merger, auto_block_partition>>::merge_sort(first, last);
+    } });
+}
+
+template<typename T>
+typename std::enable_if<sal::sort::internal::radix_key<T>::value>::type add_radix_sort(std::vector<algorithm<T>>& list)
+{
+    list.push_back({ "sal::radix_sort", true, [](T* first, T* last) { sal::sort::radix_sorter<T>::radix_sort(first, last); } });
+}
+
+template<typename T>
+typename std::enable_if<!sal::sort::internal::radix_key<T>::value>::type add_radix_sort(std::vector<algorithm<T>>&) { }
+
+template<typename T>
+std::vector<algorithm<T>> algorithms()
+{
+    using sorter = sal::sort::sorter<T>;
+
+    std::vector<algorithm<T>> list = {
+        { "std::sort", false, [](T* first, T* last) { std::sort(first, last); } },
+        { "std::stable_sort", false, [](T* first, T* last) { std::stable_sort(first, last); } },
+        { "tbb::parallel_sort", true, [](T* first, T* last) { tbb::parallel_sort(first, last); } },
+        { "sal::stable_merge_sort", true, [](T* first, T* last) { sorter::stable_merge_sort(first, last); } },
+        { "sal::sample_sort", true, [](T* first, T* last) { sorter::sample_sort(first, last); } },
+        { "sal::multiway_merge_sort", true, [](T* first, T* last) { sorter::multiway_merge_sort(first, last); } },
+        { "sal::natural_merge_sort", true, [](T* first, T* last) { sorter::natural_merge_sort(first, last); } },
+    };
+
+    add_merge_sorts<T, default_merger>(list);
+    add_merge_sorts<T, simd_merger>(list);
+    add_merge_sorts<T, auto_merger>(list);
+    add_radix_sort(list);
+    return list;
+}
+
+struct options {
+    std::vector<size_t> sizes = { 1 << 10, 1 << 20, 64 << 20 };
+    std::vector<int> threads;
+    std::vector<std::string> types = { "int32", "int64", "double", "pair" };
+    std::vector<std::string> inputs = std::vector<std::string>(std::begin(input_names), std::end(input_names));
+    std::vector<std::string> filters;
+    int min_reps = 3;
+    uint64_t seed = 1;
+    std::string output;
+};
+
+std::vector<std::string> split(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');) {
+        if (!item.empty())
+            items.push_back(item);
+    }
+
+    return items;
+}
+
+// Byte counts such as "4096", "64K", "1M" or "4G"
+size_t parse_bytes(const std::string& text)
+{
+    size_t value = std::strtoull(text.c_str(), nullptr, 10);
+    switch (text.back()) {
+        case 'K': case 'k': return value << 10;
+        case 'M': case 'm': return value << 20;
+        case 'G': case 'g': return value << 30;
+        default: return value;
+    }
+}
+
+// 1, 2, 4, ... and the number of hardware threads
+std::vector<int> default_threads()
+{
+    const int all = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<int> counts;
+    for (int t = 1; t < all; t *= 2)
+        counts.push_back(t);
+
+    counts.push_back(all);
+    return counts;
+}
+
+void usage()
+{
+    std::cerr <<
+        "usage: sal_bench [options]\n"
+        "  --sizes=LIST       input sizes in bytes with optional K/M/G suffix (1K,1M,64M)\n"
+        "  --threads=LIST     TBB thread counts (1,2,4,... up to all hardware threads)\n"
+        "  --types=LIST       int32,int64,double,pair\n"
+        "  --inputs=LIST      uniform,sorted,reversed,organ_pipe,few_unique,zipf,sawtooth,almost_sorted\n"
+        "  --algorithms=LIST  run only algorithms whose name contains one of the items\n"
+        "  --reps=N           minimum repetitions, small inputs repeat up to 16 MiB of sorting (3)\n"
+        "  --seed=N           seed of the input generators (1)\n"
+        "  --output=FILE      write the JSON there instead of stdout\n"
+        "  --list             print the algorithm names and exit\n";
+}
+
+bool selected(const options& opts, const std::string& name)
+{
+    if (opts.filters.empty())
+        return true;
+
+    for (auto& filter : opts.filters) {
+        if (name.find(filter) != std::string::npos)
+            return true;
+    }
+
+    return false;
+}
+
+std::string json_string(const std::string& text)
+{
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        quoted += c;
+    }
+
+    return quoted + '"';
+}
+
+struct result {
+    std::string algorithm;
+    std::string type;
+    std::string input;
+    size_t bytes;
+    size_t elements;
+    int threads;
+    int reps;
+    double min;
+    double median;
+    double mean;
+    bool sorted;
+};
+
+template<typename T>
+void run_type(const options& opts, std::vector<result>& results)
+{
+    const std::vector<algorithm<T>> list = algorithms<T>();
+
+    for (size_t bytes : opts.sizes) {
+        const size_t n = std::max<size_t>(1, bytes / sizeof(T));
+        aligned_vector<T> input(n), work(n);
+        const int reps = static_cast<int>(std::max<size_t>(opts.min_reps, std::min<size_t>(1000, (16 << 20) / (n * sizeof(T)))));
+
+        for (auto& name : opts.inputs) {
+            generate(name, input.data(), n, opts.seed);
+
+            for (size_t t = 0; t < opts.threads.size(); ++t) {
+                tbb::task_arena arena(opts.threads[t]);
+
+                for (auto& alg : list) {
+                    //sequential algorithms are timed once, with the first thread count
+                    if (!selected(opts, alg.name) || (!alg.parallel && t > 0))
+                        continue;
+
+                    std::cerr << key_traits<T>::name() << ' ' << name << ' ' << n << ' ' << alg.name << " x"
+                              << (alg.parallel ? opts.threads[t] : 1) << "..." << std::flush;
+
+                    std::vector<double> times;
+                    bool sorted = true;
+                    for (int rep = 0; rep < reps; ++rep) {
+                        std::copy(input.begin(), input.end(), work.begin());
+
+                        auto start = std::chrono::steady_clock::now();
+                        arena.execute([&] { alg.sort(work.data(), work.data() + n); });
+                        times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+                        sorted = sorted && std::is_sorted(work.begin(), work.end());
+                    }
+
+                    std::sort(times.begin(), times.end());
+                    double total = 0;
+                    for (double time : times)
+                        total += time;
+
+                    result r = { alg.name, key_traits<T>::name(), name, n * sizeof(T), n,
+                                 alg.parallel ? opts.threads[t] : 1, reps, times.front(), times[times.size() / 2],
+                                 total / reps, sorted };
+                    results.push_back(r);
+
+                    std::cerr << (sorted ? "" : "NOT SORTED ") << r.min << " s" << std::endl;
+                }
+            }
+        }
+    }
+}
+
+void write_json(std::ostream& out, const options& opts, const std::vector<result>& results)
+{
+    const sal::tuning::cache_info& caches = sal::tuning::host_caches();
+
+    out << "{\n  \"host\": {\n"
+        << "    \"id\": " << json_string(sal::tuning::host_id()) << ",\n"
+        << "    \"simd_level\": " << json_string(sal::dispatch::simd_level_name(sal::dispatch::active_simd_level())) << ",\n"
+        << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+        << "    \"l1d\": " << caches.l1d << ", \"l2\": " << caches.l2 << ", \"l3\": " << caches.l3 << "\n"
+        << "  },\n  \"seed\": " << opts.seed << ",\n  \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const result& r = results[i];
+        out << (i ? ",\n" : "\n")
+            << "    {\"algorithm\": " << json_string(r.algorithm) << ", \"type\": " << json_string(r.type)
+            << ", \"input\": " << json_string(r.input) << ", \"bytes\": " << r.bytes << ", \"elements\": " << r.elements
+            << ", \"threads\": " << r.threads << ", \"reps\": " << r.reps << ", \"min_seconds\": " << r.min
+            << ", \"median_seconds\": " << r.median << ", \"mean_seconds\": " << r.mean
+            << ", \"elements_per_second\": " << (r.min > 0 ? r.elements / r.min : 0)
+            << ", \"sorted\": " << (r.sorted ? "true" : "false") << "}";
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    options opts;
+    opts.threads = default_threads();
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        const std::string name = arg.substr(0, eq);
+        const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+        if (name == "--sizes") {
+            opts.sizes.clear();
+            for (auto& size : split(value))
+                opts.sizes.push_back(parse_bytes(size));
+        } else if (name == "--threads") {
+            opts.threads.clear();
+            for (auto& count : split(value))
+                opts.threads.push_back(std::max(1, std::atoi(count.c_str())));
+        } else if (name == "--types") {
+            opts.types = split(value);
+        } else if (name == "--inputs") {
+            opts.inputs = split(value);
+        } else if (name == "--algorithms") {
+            opts.filters = split(value);
+        } else if (name == "--reps") {
+            opts.min_reps = std::max(1, std::atoi(value.c_str()));
+        } else if (name == "--seed") {
+            opts.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (name == "--output") {
+            opts.output = value;
+        } else if (name == "--list") {
+            for (auto& alg : algorithms<int64_t>())
+                std::cout << alg.name << '\n';
+            return 0;
+        } else {
+            usage();
+            return name == "--help" ? 0 : 2;
+        }
+    }
+
+    for (auto& input : opts.inputs) {
+        if (std::find(std::begin(input_names), std::end(input_names), input) == std::end(input_names)) {
+            std::cerr << "unknown input " << input << std::endl;
+            return 2;
+        }
+    }
+
+    std::vector<result> results;
+    for (auto& type : opts.types) {
+        if (type == "int32")
+            run_type<int32_t>(opts, results);
+        else if (type == "int64")
+            run_type<int64_t>(opts, results);
+        else if (type == "double")
+            run_type<double>(opts, results);
+        else if (type == "pair")
+            run_type<pair_key>(opts, results);
+        else {
+            std::cerr << "unknown type " << type << std::endl;
+            return 2;
+        }
+    }
+
+    if (opts.output.empty()) {
+        write_json(std::cout, opts, results);
+    } else {
+        std::ofstream file(opts.output);
+        write_json(file, opts, results);
+    }
+
+    //a wrong result is a failure of the run, not just a slow entry
+    for (auto& r : results) {
+        if (!r.sorted)
+            return 1;
+    }
+
+    return 0;
+}
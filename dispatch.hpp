@@ -0,0 +1,138 @@
+//
+// Runtime selection of the SIMD tier used by the vector kernels.
+//
+
+#ifndef SAL_DISPATCH_HPP
+#define SAL_DISPATCH_HPP
+
+#include <cstdlib>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Kernels are compiled for their own instruction set with function level target attributes,
+// so the rest of the library can be built for the baseline architecture.
+#if defined(__GNUC__) || defined(__clang__)
+#define SAL_TARGET_SSE4 __attribute__((target("sse4.1")))
+#define SAL_TARGET_AVX2 __attribute__((target("avx2")))
+#define SAL_TARGET_AVX512 __attribute__((target("avx512f")))
+#define SAL_FLATTEN __attribute__((flatten))
+#else
+#define SAL_TARGET_SSE4
+#define SAL_TARGET_AVX2
+#define SAL_TARGET_AVX512
+#define SAL_FLATTEN
+#endif
+
+namespace sal { namespace dispatch {
+
+enum class simd_level : int {
+    scalar = 0,
+    sse4 = 1,
+    avx2 = 2,
+    avx512 = 3
+};
+
+// Environment variable that caps the tier, e.g. SAL_SIMD_LEVEL=sse4
+constexpr const char* simd_level_env = "SAL_SIMD_LEVEL";
+
+inline const char* simd_level_name(simd_level level)
+{
+    switch (level) {
+        case simd_level::avx512: return "avx512";
+        case simd_level::avx2: return "avx2";
+        case simd_level::sse4: return "sse4";
+        default: return "scalar";
+    }
+}
+
+inline bool parse_simd_level(const char* str, simd_level& level)
+{
+    const simd_level levels[] = { simd_level::scalar, simd_level::sse4, simd_level::avx2, simd_level::avx512 };
+
+    for (simd_level l : levels) {
+        if (std::strcmp(str, simd_level_name(l)) == 0) {
+            level = l;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Highest tier supported by both the processor and the operating system
+inline simd_level detect_simd_level()
+{
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+        return simd_level::avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return simd_level::avx2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return simd_level::sse4;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int regs[4] = {};
+    __cpuid(regs, 0);
+    const int max_leaf = regs[0];
+
+    __cpuid(regs, 1);
+    const bool sse4 = (regs[2] & (1 << 19)) != 0;
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+
+    if (max_leaf >= 7 && (xcr0 & 0x6) == 0x6) {
+        __cpuidex(regs, 7, 0);
+
+        if ((regs[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6)
+            return simd_level::avx512;
+        if (regs[1] & (1 << 5))
+            return simd_level::avx2;
+    }
+    if (sse4)
+        return simd_level::sse4;
+#endif
+    return simd_level::scalar;
+}
+
+// Highest tier with kernels compiled into this binary
+inline simd_level compiled_simd_level()
+{
+#if defined(_USE_AVX512_)
+    return simd_level::avx512;
+#elif defined(_USE_AVX2_)
+    return simd_level::avx2;
+#elif defined(_USE_SSE4_)
+    return simd_level::sse4;
+#else
+    return simd_level::scalar;
+#endif
+}
+
+// The override can only lower the tier, a request above what the host supports is clamped
+inline simd_level select_simd_level()
+{
+    simd_level level = detect_simd_level();
+    if (compiled_simd_level() < level)
+        level = compiled_simd_level();
+
+    simd_level forced;
+    const char* env = std::getenv(simd_level_env);
+    if (env && parse_simd_level(env, forced) && forced < level)
+        level = forced;
+
+    return level;
+}
+
+// Tier used by the dispatched kernels, evaluated once per process
+inline simd_level active_simd_level()
+{
+    static const simd_level level = select_simd_level();
+    return level;
+}
+
+}}
+
+#endif //SAL_DISPATCH_HPP
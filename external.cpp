@@ -0,0 +1,291 @@
+//
+// Out-of-core sort of binary files larger than the memory budget
+//
+#ifndef SAL_EXTERNAL_CPP
+#define SAL_EXTERNAL_CPP
+#include "external.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+namespace sal { namespace sort {
+
+namespace internal {
+
+inline binary_file::binary_file(const std::string &path, const char *mode) : file_(std::fopen(path.c_str(), mode)), path_(path)
+{
+    if (!file_)
+        throw std::runtime_error("cannot open " + path_ + ": " + std::strerror(errno));
+}
+
+inline binary_file::~binary_file()
+{
+    if (file_)
+        std::fclose(file_);
+}
+
+inline size_t binary_file::read(void *data, size_t bytes)
+{
+    size_t done = std::fread(data, 1, bytes, file_);
+    if (done < bytes && std::ferror(file_))
+        throw std::runtime_error("cannot read " + path_ + ": " + std::strerror(errno));
+
+    return done;
+}
+
+inline void binary_file::write(const void *data, size_t bytes)
+{
+    if (std::fwrite(data, 1, bytes, file_) != bytes)
+        throw std::runtime_error("cannot write " + path_ + ": " + std::strerror(errno));
+}
+
+inline void binary_file::close()
+{
+    std::FILE *file = file_;
+    file_ = nullptr;
+
+    if (std::fclose(file) != 0)
+        throw std::runtime_error("cannot close " + path_ + ": " + std::strerror(errno));
+}
+
+inline temp_files::temp_files(const std::string &dir) : count_(0)
+{
+    std::random_device rd;
+    prefix_ = (dir.empty() ? std::string(".") : dir) + "/sal_run_" + std::to_string(rd()) + "_";
+}
+
+inline temp_files::~temp_files()
+{
+    for (auto &path : paths_)
+        std::remove(path.c_str());
+}
+
+inline std::string temp_files::create()
+{
+    paths_.push_back(prefix_ + std::to_string(count_++) + ".bin");
+    return paths_.back();
+}
+
+inline void temp_files::remove(const std::string &path)
+{
+    std::remove(path.c_str());
+    paths_.erase(std::find(paths_.begin(), paths_.end(), path));
+}
+
+template<typename T>
+run_reader<T>::run_reader(const std::string &path, size_t block) : file_(path, "rb"), current_(block), ahead_(block)
+{
+    pos_ = last_ = current_.data();
+
+    T *data = ahead_.data();
+    const size_t bytes = block * sizeof(T);
+    pending_ = std::async(std::launch::async, [this, data, bytes] { return file_.read(data, bytes); });
+
+    next();
+}
+
+template<typename T>
+void run_reader<T>::advance(const T *pos)
+{
+    pos_ = pos;
+    if (pos_ == last_ && pending_.valid())
+        next();
+}
+
+template<typename T>
+void run_reader<T>::next()
+{
+    const size_t bytes = pending_.get();
+    if (bytes % sizeof(T) != 0)
+        throw std::runtime_error("truncated value in sorted run");
+
+    std::swap(current_, ahead_);
+    pos_ = current_.data();
+    last_ = pos_ + bytes / sizeof(T);
+
+    //a short block was the end of the run
+    if (bytes == current_.size() * sizeof(T)) {
+        T *data = ahead_.data();
+        pending_ = std::async(std::launch::async, [this, data, bytes] { return file_.read(data, bytes); });
+    }
+}
+
+template<typename T>
+run_writer<T>::run_writer(const std::string &path, size_t block) : file_(path, "wb"), index_(0)
+{
+    buffers_[0].resize(block);
+    buffers_[1].resize(block);
+}
+
+template<typename T>
+void run_writer<T>::commit(size_t n)
+{
+    //the other buffer is reused next, so its write has to be done
+    if (pending_.valid())
+        pending_.get();
+
+    const T *data = buffers_[index_].data();
+    pending_ = std::async(std::launch::async, [this, data, n] { file_.write(data, n * sizeof(T)); });
+    index_ ^= 1;
+}
+
+template<typename T>
+void run_writer<T>::finish()
+{
+    if (pending_.valid())
+        pending_.get();
+
+    file_.close();
+}
+
+}
+
+template<typename T, typename Sorter>
+template<typename Comparator>
+void external_sorter<T, Sorter>::sort(const std::string &input, const std::string &output, size_t memory_budget,
+                                      const std::string &temp_dir, Comparator cmp)
+{
+    //a two-way merge holds two read blocks per run and two write blocks
+    if (memory_budget < 6 * min_block_bytes)
+        throw std::invalid_argument("external sort needs a memory budget of at least 6 MiB");
+
+    internal::temp_files temp(temp_dir);
+    std::vector<std::string> runs = _generate_runs(input, memory_budget, temp, cmp);
+
+    //longest merges the budget allows with blocks of at least min_block_bytes
+    const size_t max_fan_in = memory_budget / (2 * min_block_bytes) - 1;
+
+    while (runs.size() > max_fan_in) {
+        std::vector<std::string> merged;
+        for (size_t i = 0; i < runs.size(); i += max_fan_in) {
+            std::vector<std::string> group(runs.begin() + i, runs.begin() + std::min(runs.size(), i + max_fan_in));
+            if (group.size() == 1) {
+                merged.push_back(group[0]);
+                continue;
+            }
+
+            merged.push_back(temp.create());
+            _merge_runs(group, merged.back(), memory_budget, cmp);
+
+            for (auto &run : group)
+                temp.remove(run);
+        }
+
+        runs.swap(merged);
+    }
+
+    //input that fit in one run is already sorted
+    if (runs.size() == 1 && std::rename(runs[0].c_str(), output.c_str()) == 0)
+        return;
+
+    _merge_runs(runs, output, memory_budget, cmp);
+}
+
+template<typename T, typename Sorter>
+template<typename Comparator>
+std::vector<std::string> external_sorter<T, Sorter>::_generate_runs(const std::string &input, size_t memory_budget,
+                                                                    internal::temp_files &temp, Comparator cmp)
+{
+    //two input chunks, one is read while the other is sorted into the output chunk
+    const size_t chunk = memory_budget / (3 * sizeof(T));
+    const size_t chunk_bytes = chunk * sizeof(T);
+
+    internal::scratch_vector<T> chunks[2];
+    chunks[0].resize(chunk);
+    chunks[1].resize(chunk);
+    internal::scratch_vector<T> sorted;
+    sorted.resize(chunk);
+
+    internal::binary_file in(input, "rb");
+    auto read = [&in, chunk_bytes](T *data) { return in.read(data, chunk_bytes); };
+
+    std::vector<std::string> runs;
+    std::future<size_t> pending = std::async(std::launch::async, read, chunks[0].data());
+
+    //a short chunk was the end of the input and leaves no read pending
+    for (size_t i = 0; pending.valid(); i ^= 1) {
+        const size_t bytes = pending.get();
+        if (bytes % sizeof(T) != 0)
+            throw std::runtime_error("size of " + input + " is not a multiple of the value size");
+        if (bytes == 0)
+            break;
+
+        const size_t n = bytes / sizeof(T);
+        T *data = chunks[i].data();
+
+        if (bytes == chunk_bytes)
+            pending = std::async(std::launch::async, read, chunks[i ^ 1].data());
+
+        Sorter::multiway_merge_sort(data, data + n, sorted.data(), cmp);
+
+        runs.push_back(temp.create());
+        internal::binary_file run(runs.back(), "wb");
+        run.write(sorted.data(), bytes);
+        run.close();
+    }
+
+    return runs;
+}
+
+template<typename T, typename Sorter>
+template<typename Comparator>
+void external_sorter<T, Sorter>::_merge_runs(const std::vector<std::string> &runs, const std::string &output,
+                                             size_t memory_budget, Comparator cmp)
+{
+    const size_t k = runs.size();
+    const size_t block = std::max<size_t>(1, memory_budget / ((2 * k + 2) * sizeof(T)));
+
+    std::vector<std::unique_ptr<internal::run_reader<T>>> readers;
+    readers.reserve(k);
+    for (auto &run : runs)
+        readers.emplace_back(new internal::run_reader<T>(run, block));
+
+    internal::run_writer<T> writer(output, block);
+    std::vector<merge::internal::sorted_run<T>> slices(k);
+    std::vector<size_t> splits(k);
+
+    //the runs are in the NaN-last order of the sorter, bounds and splits must use it too
+    auto order = merge::internal::scalar_order(cmp);
+
+    for (;;) {
+        //every key up to the smallest last key of the loaded blocks can be merged, later blocks
+        //only hold larger or equal keys
+        const T *bound = nullptr;
+        for (auto &reader : readers) {
+            if (!reader->empty() && (!bound || order(reader->last()[-1], *bound)))
+                bound = reader->last() - 1;
+        }
+
+        if (!bound)
+            break;
+
+        const T pivot = *bound;
+        size_t total = 0;
+        for (size_t i = 0; i < k; ++i) {
+            const T *first = readers[i]->first();
+            slices[i] = merge::internal::sorted_run<T>(first, std::upper_bound(first, readers[i]->last(), pivot, order));
+            total += slices[i].second - first;
+        }
+
+        const size_t take = std::min(total, block);
+        if (take < total) {
+            merge::internal::multiway_select(slices.data(), k, take, splits.data(), order);
+            for (size_t i = 0; i < k; ++i)
+                slices[i].second = slices[i].first + splits[i];
+        }
+
+        kway_merger<T>::merge(slices.data(), k, writer.buffer(), cmp);
+        writer.commit(take);
+
+        for (size_t i = 0; i < k; ++i)
+            readers[i]->advance(slices[i].second);
+    }
+
+    writer.finish();
+}
+
+}}
+
+#endif
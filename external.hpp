@@ -0,0 +1,147 @@
+//
+// Out-of-core sort of binary files larger than the memory budget.
+//
+
+#ifndef SAL_EXTERNAL_HPP
+#define SAL_EXTERNAL_HPP
+
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "sort.hpp"
+
+namespace sal { namespace sort {
+
+namespace internal {
+
+// Binary file accessed with large sequential reads or writes, I/O errors are thrown as std::runtime_error
+class binary_file {
+public:
+    binary_file(const std::string &path, const char *mode);
+
+    binary_file(const binary_file &) = delete;
+    binary_file &operator=(const binary_file &) = delete;
+
+    ~binary_file();
+
+    // Returns the number of bytes read, less than requested only at the end of the file
+    size_t read(void *data, size_t bytes);
+
+    void write(const void *data, size_t bytes);
+
+    void close();
+
+private:
+    std::FILE *file_;
+    std::string path_;
+};
+
+// Removes the files it owns when destroyed, so an aborted sort leaves no runs behind
+class temp_files {
+public:
+    explicit temp_files(const std::string &dir);
+
+    temp_files(const temp_files &) = delete;
+    temp_files &operator=(const temp_files &) = delete;
+
+    ~temp_files();
+
+    std::string create();
+
+    void remove(const std::string &path);
+
+private:
+    std::string prefix_;
+    size_t count_;
+    std::vector<std::string> paths_;
+};
+
+/**
+ * Sequential reader of a sorted run with read-ahead: the next block is read on another thread
+ * while the current one is merged.
+ */
+template<typename T>
+class run_reader {
+public:
+    run_reader(const std::string &path, size_t block);
+
+    const T *first() const { return pos_; }
+
+    const T *last() const { return last_; }
+
+    bool empty() const { return pos_ == last_; }
+
+    // Consumes the current block up to pos, moving to the next block when it is used up
+    void advance(const T *pos);
+
+private:
+    void next();
+
+    binary_file file_;
+    aligned_vector<T> current_;
+    aligned_vector<T> ahead_;
+    const T *pos_;
+    const T *last_;
+    std::future<size_t> pending_;
+};
+
+/**
+ * Sequential writer with write-behind: a filled block is written on another thread while the
+ * next one is produced in the second buffer.
+ */
+template<typename T>
+class run_writer {
+public:
+    run_writer(const std::string &path, size_t block);
+
+    T *buffer() { return buffers_[index_].data(); }
+
+    // Writes the first n values of buffer() and switches to the other buffer
+    void commit(size_t n);
+
+    void finish();
+
+private:
+    binary_file file_;
+    aligned_vector<T> buffers_[2];
+    size_t index_;
+    std::future<void> pending_;
+};
+
+}
+
+/**
+ * External merge sort of a binary file of T values. Runs of a third of the memory budget are
+ * sorted by Sorter while the next chunk is read, then merged with the runs double buffered on
+ * both the read and the write side. When the budget cannot hold a block of min_block_bytes for
+ * every run, groups of runs are merged into longer runs first. Not stable.
+ */
+template<typename T, typename Sorter = sorter<T>>
+class external_sorter {
+public:
+    static constexpr size_t min_block_bytes = 1 << 20;
+
+    external_sorter() = delete;
+
+    // Runs are created in temp_dir and removed before returning
+    template<typename Comparator = std::less<T>>
+    static void sort(const std::string &input, const std::string &output, size_t memory_budget,
+                     const std::string &temp_dir, Comparator cmp = Comparator());
+
+private:
+    template<typename Comparator>
+    static std::vector<std::string> _generate_runs(const std::string &input, size_t memory_budget,
+                                                   internal::temp_files &temp, Comparator cmp);
+
+    template<typename Comparator>
+    static void _merge_runs(const std::vector<std::string> &runs, const std::string &output, size_t memory_budget,
+                            Comparator cmp);
+};
+
+}}
+
+#include "external.cpp"
+
+#endif //SAL_EXTERNAL_HPP
@@ -126,7 +126,7 @@ public:
         for (int i = 0; i < N; ++i) {
             auto tm_start = std::chrono::high_resolution_clock::now();
 
-            merger<int, serial_invoker, simd_int_merger>::merge(a_.begin(), a_.end(), b_.begin(), b_.end(), res_);
+            merger<int, serial_invoker, simd_merger>::merge(a_.begin(), a_.end(), b_.begin(), b_.end(), res_);
 
             auto tm_end = std::chrono::high_resolution_clock::now();
             std::chrono::duration<double> elapsed = tm_end - tm_start;
@@ -147,7 +147,7 @@ public:
         for (int i = 0; i < N; ++i) {
             auto tm_start = std::chrono::high_resolution_clock::now();
 
-            merger<int, parallel_invoker, simd_int_merger, simple_block_partition<64>>
+            merger<int, parallel_invoker, simd_merger, simple_block_partition<64>>
             ::merge(a_.begin(), a_.end(), b_.begin(), b_.end(), res_);
 
             auto tm_end = std::chrono::high_resolution_clock::now();
@@ -274,7 +274,7 @@ void test_index_merge()
 
     print_seq("[StartInput]", c.begin(), c.end());
 
-   sal::merge::merger<int, serial_invoker, simd_int_merger, static_block_partition<4>>
+   sal::merge::merger<int, serial_invoker, simd_merger, static_block_partition<4>>
    ::merge(c.begin(), mid, c.end(), out.begin());
 
     print_seq("[Resulting output]", out.begin(), out.end());
@@ -364,6 +364,8 @@ void parallel_randomize(int* a, size_t n ) {
 
 int main() {
 
+    std::cout<<"SIMD level: "<<sal::dispatch::simd_level_name(sal::dispatch::active_simd_level())<<std::endl;
+
     std::cout<<"Initializing memory..."<<std::flush;
 
     auto tm_start = std::chrono::high_resolution_clock::now();
@@ -396,7 +398,7 @@ int main() {
     //simple way
     //sal::sort::sorter<int>::merge_sort(a.begin(), a.end(), res.begin());
 
-    sal::sort::sorter<int, serial_invoker, 8192, merger_settings<simd_int_merger, static_block_partition<8192>>>
+    sal::sort::sorter<int, serial_invoker, 8192, merger_settings<simd_merger, static_block_partition<8192>>>
     ::merge_sort(a.begin(), a.end(), res.begin());
 
 
@@ -7,11 +7,12 @@
 
 namespace sal { namespace merge {
 
-template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition>
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
 template<typename Comparator>
-void merger<T, Invoker, BlockMerger, BlockPartition>::_dac_merge(const T *t, long long p1, long long r1,
+void merger<T, Invoker, BlockMerger, BlockPartition, Stats>::_dac_merge(const T *t, long long p1, long long r1,
                 const T *t2, long long p2, long long r2,
-                T *a, long long p3, Comparator cmp, size_t block_size, BlockMerger block_merger, Invoker invoker) {
+                T *a, long long p3, Comparator cmp, size_t block_size, BlockMerger block_merger, Invoker invoker,
+                unsigned depth) {
     long long n1 = r1 - p1 + 1;
     long long n2 = r2 - p2 + 1;
     if (n1 < n2) {
@@ -23,22 +24,248 @@ void merger<T, Invoker, BlockMerger, BlockPartition>::_dac_merge(const T *t, lon
     if (n1 == 0) return;
 
     if ((size_t)(n1 + n2) <= block_size) {
+        const auto started = Stats::start();
         block_merger(&t[p1], &t[p1 + n1], &t2[p2], &t2[p2 + n2], &a[p3], cmp);
+        Stats::block_merge(n1 + n2, started);
     }
     else {
 
         long long q1 = (p1 + r1) / 2;
-        long long q2 = binary_search(t[q1], t2, p2, r2);
+        long long q2 = binary_search(t[q1], t2, p2, r2, internal::scalar_order(cmp));
         long long q3 = p3 + (q1 - p1) + (q2 - p2);
         a[q3] = t[q1];
+        Stats::search(n2);
+        Invoker task_invoker = utils::subproblem(invoker, (size_t)(n1 + n2), depth);
+        Stats::merge_spawn(depth, utils::is_serial(task_invoker) ? 0 : 2);
+
+        //halves run by other threads count as the merge phase of the caller
+        SAL_PERF_CURRENT(phase);
+        task_invoker(
+        [&]{SAL_PERF_SCOPE(resumed, phase); _dac_merge(t, p1, q1 - 1, t2, p2, q2 - 1, a, p3, cmp, block_size, block_merger, task_invoker, depth + 1);},
+        [&]{SAL_PERF_SCOPE(resumed, phase); _dac_merge(t, q1 + 1, r1, t2, q2, r2, a, q3 + 1, cmp, block_size, block_merger, task_invoker, depth + 1);}
+        );
+    }
+}
+
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
+template<typename V, typename Comparator>
+void merger<T, Invoker, BlockMerger, BlockPartition, Stats>::_dac_merge_by_key(const T *t, const V *v, long long p1, long long r1,
+                const T *t2, const V *v2, long long p2, long long r2,
+                T *a, V *av, long long p3, Comparator cmp, size_t block_size, BlockMerger block_merger, Invoker invoker,
+                unsigned depth) {
+    long long n1 = r1 - p1 + 1;
+    long long n2 = r2 - p2 + 1;
+    if (n1 < n2) {
+        std::swap(t, t2);
+        std::swap(v, v2);
+        std::swap(p1, p2);
+        std::swap(r1, r2);
+        std::swap(n1, n2);
+    }
+    if (n1 == 0) return;
+
+    if ((size_t)(n1 + n2) <= block_size) {
+        const auto started = Stats::start();
+        block_merger(&t[p1], &t[p1 + n1], &v[p1], &t2[p2], &t2[p2 + n2], &v2[p2], &a[p3], &av[p3], cmp);
+        Stats::block_merge(n1 + n2, started);
+    }
+    else {
 
-        invoker(
-        [&]{_dac_merge(t, p1, q1 - 1, t2, p2, q2 - 1, a, p3, cmp, block_size, block_merger, invoker);},
-        [&]{_dac_merge(t, q1 + 1, r1, t2, q2, r2, a, q3 + 1, cmp, block_size, block_merger, invoker);}
+        long long q1 = (p1 + r1) / 2;
+        long long q2 = binary_search(t[q1], t2, p2, r2, internal::scalar_order(cmp));
+        long long q3 = p3 + (q1 - p1) + (q2 - p2);
+        a[q3] = t[q1];
+        av[q3] = v[q1];
+        Stats::search(n2);
+        Invoker task_invoker = utils::subproblem(invoker, (size_t)(n1 + n2), depth);
+        Stats::merge_spawn(depth, utils::is_serial(task_invoker) ? 0 : 2);
+
+        SAL_PERF_CURRENT(phase);
+        task_invoker(
+        [&]{SAL_PERF_SCOPE(resumed, phase); _dac_merge_by_key(t, v, p1, q1 - 1, t2, v2, p2, q2 - 1, a, av, p3, cmp, block_size, block_merger, task_invoker, depth + 1);},
+        [&]{SAL_PERF_SCOPE(resumed, phase); _dac_merge_by_key(t, v, q1 + 1, r1, t2, v2, q2, r2, a, av, q3 + 1, cmp, block_size, block_merger, task_invoker, depth + 1);}
         );
     }
 }
 
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
+template<typename Comparator>
+void merger<T, Invoker, BlockMerger, BlockPartition, Stats>::_partitioned_merge(const T *t, long long p1, long long r1,
+                const T *t2, long long p2, long long r2,
+                T *a, long long p3, Comparator cmp, Invoker invoker) {
+    size_t n12 = (size_t)((r1 - p1 + 1) + (r2 - p2 + 1));
+
+    if (is_merge_path_partition<BlockPartition>::value)
+        _merge_path(t, p1, r1, t2, p2, r2, a, p3, cmp, partition<BlockPartition>(n12, invoker), BlockMerger(), invoker);
+    else
+        _dac_merge(t, p1, r1, t2, p2, r2, a, p3, cmp, partition<BlockPartition>(n12, invoker), BlockMerger(), invoker);
+}
+
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
+template<typename V, typename Comparator>
+void merger<T, Invoker, BlockMerger, BlockPartition, Stats>::_partitioned_merge_by_key(const T *t, const V *v, long long p1, long long r1,
+                const T *t2, const V *v2, long long p2, long long r2,
+                T *a, V *av, long long p3, Comparator cmp, Invoker invoker) {
+    size_t n12 = (size_t)((r1 - p1 + 1) + (r2 - p2 + 1));
+
+    if (is_merge_path_partition<BlockPartition>::value)
+        _merge_path_by_key(t, v, p1, r1, t2, v2, p2, r2, a, av, p3, cmp, partition<BlockPartition>(n12, invoker), BlockMerger(), invoker);
+    else
+        _dac_merge_by_key(t, v, p1, r1, t2, v2, p2, r2, a, av, p3, cmp, partition<BlockPartition>(n12, invoker), BlockMerger(), invoker);
+}
+
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
+template<typename Comparator>
+void merger<T, Invoker, BlockMerger, BlockPartition, Stats>::_merge_path(const T *t, long long p1, long long r1,
+                const T *t2, long long p2, long long r2,
+                T *a, long long p3, Comparator cmp, size_t parts, BlockMerger block_merger, Invoker invoker) {
+    long long n1 = r1 - p1 + 1;
+    long long n2 = r2 - p2 + 1;
+    long long n12 = n1 + n2;
+    if (n12 == 0) return;
+
+    const T *first1 = &t[p1];
+    const T *first2 = &t2[p2];
+    T *out = &a[p3];
+
+    //piece k writes the output diagonals [d_k, d_k+1), both ends found by co-rank searches
+    Stats::merge_spawn(0, utils::is_serial(invoker) ? 0 : parts);
+    SAL_PERF_CURRENT(phase);
+    utils::parallel_for(invoker, (size_t)0, parts, [&](size_t k) {
+        SAL_PERF_SCOPE(resumed, phase);
+        long long d = n12 * (long long)k / (long long)parts;
+        long long d_next = n12 * (long long)(k + 1) / (long long)parts;
+        long long i = internal::co_rank(d, first1, n1, first2, n2, cmp);
+        long long i_next = internal::co_rank(d_next, first1, n1, first2, n2, cmp);
+        Stats::search(std::min(n1, n2), 2);
+
+        const auto started = Stats::start();
+        BlockMerger merger_copy = block_merger;
+        merger_copy(first1 + i, first1 + i_next, first2 + (d - i), first2 + (d_next - i_next), out + d, cmp);
+        Stats::block_merge(d_next - d, started);
+    });
+}
+
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
+template<typename V, typename Comparator>
+void merger<T, Invoker, BlockMerger, BlockPartition, Stats>::_merge_path_by_key(const T *t, const V *v, long long p1, long long r1,
+                const T *t2, const V *v2, long long p2, long long r2,
+                T *a, V *av, long long p3, Comparator cmp, size_t parts, BlockMerger block_merger, Invoker invoker) {
+    long long n1 = r1 - p1 + 1;
+    long long n2 = r2 - p2 + 1;
+    long long n12 = n1 + n2;
+    if (n12 == 0) return;
+
+    const T *first1 = &t[p1];
+    const T *first2 = &t2[p2];
+
+    Stats::merge_spawn(0, utils::is_serial(invoker) ? 0 : parts);
+    SAL_PERF_CURRENT(phase);
+    utils::parallel_for(invoker, (size_t)0, parts, [&](size_t k) {
+        SAL_PERF_SCOPE(resumed, phase);
+        long long d = n12 * (long long)k / (long long)parts;
+        long long d_next = n12 * (long long)(k + 1) / (long long)parts;
+        long long i = internal::co_rank(d, first1, n1, first2, n2, cmp);
+        long long i_next = internal::co_rank(d_next, first1, n1, first2, n2, cmp);
+        long long j = d - i;
+        long long j_next = d_next - i_next;
+        Stats::search(std::min(n1, n2), 2);
+
+        const auto started = Stats::start();
+        BlockMerger merger_copy = block_merger;
+        merger_copy(first1 + i, first1 + i_next, &v[p1 + i], first2 + j, first2 + j_next, &v2[p2 + j],
+                    &a[p3 + d], &av[p3 + d], cmp);
+        Stats::block_merge(d_next - d, started);
+    });
+}
+
+namespace internal {
+
+template<typename T, typename Comparator>
+T *kway_merge(const sorted_run<T> *runs, size_t k, T *out, Comparator cmp) {
+    std::vector<sorted_run<T>> cur;
+    cur.reserve(k);
+    for (size_t i = 0; i < k; ++i) {
+        if (runs[i].first != runs[i].second)
+            cur.push_back(runs[i]);
+    }
+
+    if (cur.empty())
+        return out;
+    if (cur.size() == 1)
+        return std::copy(cur[0].first, cur[0].second, out);
+    if (cur.size() == 2)
+        return std::merge(cur[0].first, cur[0].second, cur[1].first, cur[1].second, out, cmp);
+
+    loser_tree<T, Comparator> tree(cur.size(), cmp);
+    for (size_t i = 0; i < cur.size(); ++i)
+        tree.set_start(i, *cur[i].first);
+    tree.build();
+
+    while (!tree.empty()) {
+        sorted_run<T> &run = cur[tree.min_source()];
+        *out++ = tree.min_key();
+
+        ++run.first;
+        tree.replace_min(run.first != run.second ? run.first : nullptr);
+    }
+
+    return out;
+}
+
+template<typename T, typename Comparator>
+void multiway_select(const sorted_run<T> *runs, size_t k, size_t rank, size_t *splits, Comparator cmp) {
+    std::vector<size_t> lo(k, 0), hi(k), pos(k);
+    for (size_t i = 0; i < k; ++i)
+        hi[i] = runs[i].second - runs[i].first;
+
+    for (;;) {
+        size_t q = k;
+        size_t widest = 0;
+        for (size_t i = 0; i < k; ++i) {
+            if (hi[i] - lo[i] > widest) {
+                widest = hi[i] - lo[i];
+                q = i;
+            }
+        }
+
+        if (q == k)
+            break;
+
+        //keys ordered before the pivot, equal keys of lower runs order first
+        const size_t m = lo[q] + (hi[q] - lo[q]) / 2;
+        const T &pivot = runs[q].first[m];
+        size_t count = 0;
+        for (size_t i = 0; i < k; ++i) {
+            const T *first = runs[i].first + lo[i];
+            const T *last = runs[i].first + hi[i];
+            if (i < q)
+                pos[i] = std::upper_bound(first, last, pivot, cmp) - runs[i].first;
+            else if (i > q)
+                pos[i] = std::lower_bound(first, last, pivot, cmp) - runs[i].first;
+            else
+                pos[i] = m;
+            count += pos[i];
+        }
+
+        if (count == rank) {
+            std::copy(pos.begin(), pos.end(), splits);
+            return;
+        }
+
+        if (count < rank) {
+            lo = pos;
+            lo[q] = m + 1;
+        }
+        else {
+            hi = pos;
+        }
+    }
+
+    std::copy(lo.begin(), lo.end(), splits);
+}
+
+}
 
 /*
 template<typename T, typename BlockMerger, typename BlockPartition>
@@ -77,167 +304,190 @@ namespace internal {
 namespace kernel
 {
 
-#ifdef _USE_AVX2_
-inline void merge_avx2_8x8_32bit(__m256i &vA, __m256i &vB, // input
-                                 __m256i &vMin, __m256i &vMax) { // output
-    __m256i vTmp;
-
-    //TODO doesnt work properly
-    //pass 1
-    vTmp = _mm256_min_epu32(vA, vB);
-    vMax = _mm256_max_epu32(vA, vB);
-    vTmp = _mm256_alignr_epi8(vTmp, vTmp, 4);
-
-    //pass 2
-    vMin = _mm256_min_epu32(vTmp, vMax);
-    vMax = _mm256_max_epu32(vTmp, vMax);
-    vTmp = _mm256_alignr_epi8(vMin, vMin, 4);
+/*
+ * Lane operations of every instruction set are parameterized on the key order:
+ *  signed_order     - native signed compares (epi32)
+ *  unsigned_order   - native unsigned compares (epu32)
+ *  sign_flip_order  - unsigned keys are XORed with the sign bit on load and store
+ *                     and compared signed, for lanes without unsigned min/max
+ */
 
-    //pass 3
-    vMin = _mm256_min_epu32(vTmp, vMax);
-    vMax = _mm256_max_epu32(vTmp, vMax);
-    vTmp = _mm256_alignr_epi8(vMin, vMin, 4);
+#ifdef _USE_AVX2_
+template<>
+struct avx2_32bit_ops<signed_order>
+{
+    SAL_TARGET_AVX2 static __m256i min(const __m256i &a, const __m256i &b) { return _mm256_min_epi32(a, b); }
+    SAL_TARGET_AVX2 static __m256i max(const __m256i &a, const __m256i &b) { return _mm256_max_epi32(a, b); }
+    SAL_TARGET_AVX2 static __m256i gt(const __m256i &a, const __m256i &b) { return _mm256_cmpgt_epi32(a, b); }
+    SAL_TARGET_AVX2 static __m256i encode(const __m256i &v) { return v; }
+    SAL_TARGET_AVX2 static __m256i decode(const __m256i &v) { return v; }
+};
+
+template<>
+struct avx2_32bit_ops<unsigned_order>
+{
+    SAL_TARGET_AVX2 static __m256i min(const __m256i &a, const __m256i &b) { return _mm256_min_epu32(a, b); }
+    SAL_TARGET_AVX2 static __m256i max(const __m256i &a, const __m256i &b) { return _mm256_max_epu32(a, b); }
+    SAL_TARGET_AVX2 static __m256i encode(const __m256i &v) { return v; }
+    SAL_TARGET_AVX2 static __m256i decode(const __m256i &v) { return v; }
+};
+
+template<>
+struct avx2_32bit_ops<sign_flip_order> : avx2_32bit_ops<signed_order>
+{
+    SAL_TARGET_AVX2 static __m256i encode(const __m256i &v) { return _mm256_xor_si256(v, _mm256_set1_epi32(INT32_MIN)); }
+    SAL_TARGET_AVX2 static __m256i decode(const __m256i &v) { return encode(v); }
+};
+
+// Sorts a bitonic sequence of 8 lanes (distance 4, 2 and 1 half-cleaners)
+template<typename Order, bool Descending>
+SAL_TARGET_AVX2 inline void bitonic_clean_avx2_8x32bit(__m256i &v) {
+    using ops = avx2_32bit_ops<Order>;
+    __m256i vTmp, vLo, vHi;
+
+    //distance 4
+    vTmp = _mm256_permute2x128_si256(v, v, 0x01);
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = Descending ? _mm256_blend_epi32(vHi, vLo, 0xF0) : _mm256_blend_epi32(vLo, vHi, 0xF0);
+
+    //distance 2
+    vTmp = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = Descending ? _mm256_blend_epi32(vHi, vLo, 0xCC) : _mm256_blend_epi32(vLo, vHi, 0xCC);
+
+    //distance 1
+    vTmp = _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = Descending ? _mm256_blend_epi32(vHi, vLo, 0xAA) : _mm256_blend_epi32(vLo, vHi, 0xAA);
+}
 
-    //pass 4
-    vMin = _mm256_min_epu32(vTmp, vMax);
-    vMax = _mm256_max_epu32(vTmp, vMax);
-    vMin = _mm256_alignr_epi8(vMin, vMin, 4);
+// Bitonic merge of two sorted 8-lane vectors. Input and output registers may alias.
+template<typename Order>
+SAL_TARGET_AVX2 inline void merge_avx2_8x8_32bit(__m256i &vA, __m256i &vB, // input
+                                                 __m256i &vMin, __m256i &vMax) { // output
+    using ops = avx2_32bit_ops<Order>;
 
-    __m128i pm1 = _mm256_extractf128_si256(vMin, 0);
-    __m128i pm2 = _mm256_extractf128_si256(vMax, 0);
+    //A followed by reversed B is a bitonic sequence
+    __m256i vRev = _mm256_permutevar8x32_epi32(vB, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
 
-    __m128i pmx1 = _mm256_extractf128_si256(vMin, 1);
-    __m128i pmx2 = _mm256_extractf128_si256(vMax, 1);
+    //pass 1: every lane of L is not greater than any lane of H, both halves stay bitonic
+    __m256i vL = ops::min(vA, vRev);
+    __m256i vH = ops::max(vA, vRev);
 
+    //passes 2-4
+    bitonic_clean_avx2_8x32bit<Order, false>(vL);
+    bitonic_clean_avx2_8x32bit<Order, false>(vH);
 
-    vMin = _mm256_set_m128i(pm2, pm1);
-    vMax = _mm256_set_m128i(pmx2, pmx1);
+    vMin = vL;
+    vMax = vH;
 }
 
 
-inline void merge_256i(const int *a, const int *b, int *res) {
+SAL_TARGET_AVX2 inline void merge_256i(const int *a, const int *b, int *res) {
     __m256i m1 = _mm256_load_si256((__m256i *) a);
     __m256i m2 = _mm256_load_si256((__m256i *) b);
     __m256i vmin, vmax;
 
-    merge_avx2_8x8_32bit(m1, m2, vmin, vmax);
+    merge_avx2_8x8_32bit<signed_order>(m1, m2, vmin, vmax);
 
     _mm256_store_si256((__m256i *) res, vmin);
     _mm256_store_si256((__m256i *) &res[8], vmax);
 }
 
-inline void reverse_merge_avx2_8x8_32bit(__m256i &vA, __m256i &vB, // input
-                                 __m256i &vMin, __m256i &vMax) { // output
-    __m256i vTmp;
-
-    using utils::_print_register;
-
-    _print_register(vA, "vA");
-    _print_register(vB, "vB");
-
-    //pass 1
-    vTmp = _mm256_max_epu32(vA, vB);
-    vMax = _mm256_min_epu32(vB, vB);
-
-    _print_register(vTmp, "vMin");
-    _print_register(vMax, "vMax");
-
-    vTmp = _mm256_alignr_epi8(vTmp, vTmp, 4);
-
-    _print_register(vTmp, "vMax");
-
-    //pass 2
-    vMin = _mm256_min_epu32(vTmp, vMax);
-    vMax = _mm256_max_epu32(vTmp, vMax);
-
-    _print_register(vMin, "vMin");
-    _print_register(vMax, "vMax");
-
-    vTmp = _mm256_alignr_epi8(vMax, vMax, 4);
-
-    _print_register(vTmp, "vTmp");
-
-    //pass 3
-    vMin = _mm256_min_epu32(vTmp, vMax);
-    vMax = _mm256_max_epu32(vTmp, vMax);
-
-    _print_register(vMin, "vMin");
-    _print_register(vMax, "vMax");
-
-    vTmp = _mm256_alignr_epi8(vMax, vMax, 4);
-
-    _print_register(vTmp, "vTmp");
-
-    //pass 4
-    vMin = _mm256_min_epu32(vTmp, vMax);
-    vMax = _mm256_max_epu32(vTmp, vMax);
-
-    _print_register(vMin, "vMin");
-    _print_register(vMax, "vMax");
+// Merges two descending 8-lane vectors: vMax receives the 8 largest keys and vMin the 8 smallest,
+// both in descending order. Input and output registers may alias.
+template<typename Order>
+SAL_TARGET_AVX2 inline void reverse_merge_avx2_8x8_32bit(__m256i &vA, __m256i &vB, // input
+                                                         __m256i &vMin, __m256i &vMax) { // output
+    using ops = avx2_32bit_ops<Order>;
 
-    vMax = _mm256_alignr_epi8(vMax, vMax, 4);
+    __m256i vRev = _mm256_permutevar8x32_epi32(vB, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
 
-    _print_register(vMax, "vMax");
+    __m256i vL = ops::min(vA, vRev);
+    __m256i vH = ops::max(vA, vRev);
 
-    __m128i pm1 = _mm256_extractf128_si256(vMin, 0);
-    __m128i pm2 = _mm256_extractf128_si256(vMax, 0);
+    bitonic_clean_avx2_8x32bit<Order, true>(vL);
+    bitonic_clean_avx2_8x32bit<Order, true>(vH);
 
-    __m128i pmx1 = _mm256_extractf128_si256(vMin, 1);
-    __m128i pmx2 = _mm256_extractf128_si256(vMax, 1);
-
-
-    vMin = _mm256_set_m128i(pm2, pm1);
-    vMax = _mm256_set_m128i(pmx2, pmx1);
+    vMin = vL;
+    vMax = vH;
 }
 
 
-inline void reverse_merge_256i(const int *a, const int *b, int *res) {
+SAL_TARGET_AVX2 inline void reverse_merge_256i(const int *a, const int *b, int *res) {
     __m256i m1 = _mm256_load_si256((__m256i *) a);
     __m256i m2 = _mm256_load_si256((__m256i *) b);
     __m256i vmin, vmax;
 
-    reverse_merge_avx2_8x8_32bit(m1, m2, vmin, vmax);
+    reverse_merge_avx2_8x8_32bit<signed_order>(m1, m2, vmin, vmax);
 
-    _mm256_store_si256((__m256i *) res, vmin);
-    _mm256_store_si256((__m256i *) &res[8], vmax);
+    _mm256_store_si256((__m256i *) res, vmax);
+    _mm256_store_si256((__m256i *) &res[8], vmin);
 }
 
 #endif
 
 #ifdef _USE_SSE4_
-
-inline void merge_4x4_32bit(__m128i &vA, __m128i &vB, // input 1 & 2
-                            __m128i &vMin, __m128i &vMax) { // output
+template<>
+struct sse4_32bit_ops<signed_order>
+{
+    SAL_TARGET_SSE4 static __m128i min(const __m128i &a, const __m128i &b) { return _mm_min_epi32(a, b); }
+    SAL_TARGET_SSE4 static __m128i max(const __m128i &a, const __m128i &b) { return _mm_max_epi32(a, b); }
+    SAL_TARGET_SSE4 static __m128i encode(const __m128i &v) { return v; }
+    SAL_TARGET_SSE4 static __m128i decode(const __m128i &v) { return v; }
+};
+
+template<>
+struct sse4_32bit_ops<unsigned_order>
+{
+    SAL_TARGET_SSE4 static __m128i min(const __m128i &a, const __m128i &b) { return _mm_min_epu32(a, b); }
+    SAL_TARGET_SSE4 static __m128i max(const __m128i &a, const __m128i &b) { return _mm_max_epu32(a, b); }
+    SAL_TARGET_SSE4 static __m128i encode(const __m128i &v) { return v; }
+    SAL_TARGET_SSE4 static __m128i decode(const __m128i &v) { return v; }
+};
+
+template<>
+struct sse4_32bit_ops<sign_flip_order> : sse4_32bit_ops<signed_order>
+{
+    SAL_TARGET_SSE4 static __m128i encode(const __m128i &v) { return _mm_xor_si128(v, _mm_set1_epi32(INT32_MIN)); }
+    SAL_TARGET_SSE4 static __m128i decode(const __m128i &v) { return encode(v); }
+};
+
+template<typename Order>
+SAL_TARGET_SSE4 inline void merge_4x4_32bit(__m128i &vA, __m128i &vB, // input 1 & 2
+                                            __m128i &vMin, __m128i &vMax) { // output
+    using ops = sse4_32bit_ops<Order>;
     __m128i vTmp; // temporary register
-    vTmp = _mm_min_epu32(vA, vB);
-    vMax = _mm_max_epu32(vA, vB);
+    vTmp = ops::min(vA, vB);
+    vMax = ops::max(vA, vB);
     vTmp = _mm_alignr_epi8(vTmp, vTmp, 4);
-    vMin = _mm_min_epu32(vTmp, vMax);
-    vMax = _mm_max_epu32(vTmp, vMax);
+    vMin = ops::min(vTmp, vMax);
+    vMax = ops::max(vTmp, vMax);
     vTmp = _mm_alignr_epi8(vMin, vMin, 4);
-    vMin = _mm_min_epu32(vTmp, vMax);
-    vMax = _mm_max_epu32(vTmp, vMax);
+    vMin = ops::min(vTmp, vMax);
+    vMax = ops::max(vTmp, vMax);
     vTmp = _mm_alignr_epi8(vMin, vMin, 4);
-    vMin = _mm_min_epu32(vTmp, vMax);
-    vMax = _mm_max_epu32(vTmp, vMax);
+    vMin = ops::min(vTmp, vMax);
+    vMax = ops::max(vTmp, vMax);
     vMin = _mm_alignr_epi8(vMin, vMin, 4);
 }
-inline void merge_8x8_32bit(__m128i &vA0, __m128i &vA1, // input 1
+template<typename Order>
+SAL_TARGET_SSE4 inline void merge_8x8_32bit(__m128i &vA0, __m128i &vA1, // input 1
         __m128i &vB0, __m128i &vB1, // input 2
         __m128i &vMin0, __m128i &vMin1, // output
         __m128i &vMax0, __m128i &vMax1) { // output
 // 1st step
-merge_4x4_32bit(vA1,vB1,vMin1,vMax1);
-merge_4x4_32bit(vA0,vB0,vMin0,vMax0);
+merge_4x4_32bit<Order>(vA1,vB1,vMin1,vMax1);
+merge_4x4_32bit<Order>(vA0,vB0,vMin0,vMax0);
 // 2nd step
-merge_4x4_32bit(vMax0,vMin1,vMin1,vMax0);
+merge_4x4_32bit<Order>(vMax0,vMin1,vMin1,vMax0);
 }
 
 
-inline void merge_8x8_128i(const int *a, const int *b, int *res) {
-
-//    utils::print_array(a, 8, "a");
-//    utils::print_array(b, 8, "b");
+SAL_TARGET_SSE4 inline void merge_8x8_128i(const int *a, const int *b, int *res) {
 
     __m128i a1 = _mm_loadu_si128((__m128i *) a);
     __m128i a2 = _mm_loadu_si128((__m128i *) &a[4]);
@@ -245,30 +495,1008 @@ inline void merge_8x8_128i(const int *a, const int *b, int *res) {
     __m128i b2 = _mm_loadu_si128((__m128i *) &b[4]);
     __m128i vmin1, vmin2, vmax1, vmax2;
 
-//    utils::_print_register128(a1, "a1");
-//    utils::_print_register128(a2, "a2");
-//    utils::_print_register128(b1, "b1");
-//    utils::_print_register128(b2, "b2");
-    merge_8x8_32bit(a1, a2, b1, b2, vmin1, vmin2, vmax1, vmax2);
-
-//    utils::_print_register128(vmin1, "vmin1");
-//    utils::_print_register128(vmin2, "vmin2");
-//    utils::_print_register128(vmax1, "vmax1");
-//    utils::_print_register128(vmax2, "vmax2");
+    merge_8x8_32bit<signed_order>(a1, a2, b1, b2, vmin1, vmin2, vmax1, vmax2);
 
     _mm_storeu_si128((__m128i *) res, vmin1);
     _mm_storeu_si128((__m128i *) &res[4], vmin2);
     _mm_storeu_si128((__m128i *) &res[8], vmax1);
     _mm_storeu_si128((__m128i *) &res[12], vmax2);
+}
+
+#endif
+
+#ifdef _USE_AVX512_
+// GCC 12 reports the self-initialized _mm512_undefined_* values inside the AVX-512 intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+template<>
+struct avx512_32bit_ops<signed_order>
+{
+    SAL_TARGET_AVX512 static __m512i min(const __m512i &a, const __m512i &b) { return _mm512_min_epi32(a, b); }
+    SAL_TARGET_AVX512 static __m512i max(const __m512i &a, const __m512i &b) { return _mm512_max_epi32(a, b); }
+    SAL_TARGET_AVX512 static __m512i encode(const __m512i &v) { return v; }
+    SAL_TARGET_AVX512 static __m512i decode(const __m512i &v) { return v; }
+};
+
+template<>
+struct avx512_32bit_ops<unsigned_order>
+{
+    SAL_TARGET_AVX512 static __m512i min(const __m512i &a, const __m512i &b) { return _mm512_min_epu32(a, b); }
+    SAL_TARGET_AVX512 static __m512i max(const __m512i &a, const __m512i &b) { return _mm512_max_epu32(a, b); }
+    SAL_TARGET_AVX512 static __m512i encode(const __m512i &v) { return v; }
+    SAL_TARGET_AVX512 static __m512i decode(const __m512i &v) { return v; }
+};
+
+template<>
+struct avx512_32bit_ops<sign_flip_order> : avx512_32bit_ops<signed_order>
+{
+    SAL_TARGET_AVX512 static __m512i encode(const __m512i &v) { return _mm512_xor_si512(v, _mm512_set1_epi32(INT32_MIN)); }
+    SAL_TARGET_AVX512 static __m512i decode(const __m512i &v) { return encode(v); }
+};
+
+// Sorts a bitonic sequence of 16 lanes
+template<typename Order>
+SAL_TARGET_AVX512 inline void bitonic_clean_avx512_16x32bit(__m512i &v) {
+    using ops = avx512_32bit_ops<Order>;
+    __m512i vTmp, vLo, vHi;
+
+    //distance 8
+    vTmp = _mm512_shuffle_i64x2(v, v, _MM_SHUFFLE(1, 0, 3, 2));
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = _mm512_mask_blend_epi32(0xFF00, vLo, vHi);
+
+    //distance 4
+    vTmp = _mm512_shuffle_i64x2(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = _mm512_mask_blend_epi32(0xF0F0, vLo, vHi);
+
+    //distance 2
+    vTmp = _mm512_shuffle_epi32(v, _MM_PERM_BADC);
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = _mm512_mask_blend_epi32(0xCCCC, vLo, vHi);
+
+    //distance 1
+    vTmp = _mm512_shuffle_epi32(v, _MM_PERM_CDAB);
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = _mm512_mask_blend_epi32(0xAAAA, vLo, vHi);
+}
 
-    //utils::print_array(res, 16, "res");
+// Bitonic merge of two sorted 16-lane vectors. Input and output registers may alias.
+template<typename Order>
+SAL_TARGET_AVX512 inline void merge_avx512_16x16_32bit(__m512i &vA, __m512i &vB, // input
+                                                       __m512i &vMin, __m512i &vMax) { // output
+    using ops = avx512_32bit_ops<Order>;
+
+    __m512i vRev = _mm512_permutexvar_epi32(
+            _mm512_setr_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0), vB);
+
+    __m512i vL = ops::min(vA, vRev);
+    __m512i vH = ops::max(vA, vRev);
+
+    bitonic_clean_avx512_16x32bit<Order>(vL);
+    bitonic_clean_avx512_16x32bit<Order>(vH);
+
+    vMin = vL;
+    vMax = vH;
 }
 
+template<typename T, typename Order = typename key_order<T>::type>
+struct avx512_32bit_kernel
+{
+    using value_type = T;
+    using reg_type = __m512i;
+    using ops = avx512_32bit_ops<Order>;
+    static constexpr size_t width = 16;
+
+    SAL_TARGET_AVX512 static void load(const T *p, reg_type &v) { v = ops::encode(_mm512_loadu_si512(p)); }
+    SAL_TARGET_AVX512 static void store(T *p, const reg_type &v) { _mm512_storeu_si512(p, ops::decode(v)); }
+
+    SAL_TARGET_AVX512 static void merge(reg_type &vA, reg_type &vB, reg_type &vMin, reg_type &vMax)
+    {
+        merge_avx512_16x16_32bit<Order>(vA, vB, vMin, vMax);
+    }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
 #endif
 
+#ifdef _USE_AVX2_
+template<typename T, typename Order = typename key_order<T>::type>
+struct avx2_32bit_kernel
+{
+    using value_type = T;
+    using reg_type = __m256i;
+    using ops = avx2_32bit_ops<Order>;
+    static constexpr size_t width = 8;
+
+    SAL_TARGET_AVX2 static void load(const T *p, reg_type &v)
+    {
+        v = ops::encode(_mm256_loadu_si256((const __m256i *) p));
+    }
+
+    SAL_TARGET_AVX2 static void store(T *p, const reg_type &v)
+    {
+        _mm256_storeu_si256((__m256i *) p, ops::decode(v));
+    }
 
+    SAL_TARGET_AVX2 static void merge(reg_type &vA, reg_type &vB, reg_type &vMin, reg_type &vMax)
+    {
+        merge_avx2_8x8_32bit<Order>(vA, vB, vMin, vMax);
+    }
+};
+#endif
+
+#ifdef _USE_SSE4_
+template<typename T, typename Order = typename key_order<T>::type>
+struct sse4_32bit_kernel
+{
+    using value_type = T;
+    struct reg_type { __m128i lo, hi; };
+    using ops = sse4_32bit_ops<Order>;
+    static constexpr size_t width = 8;
+
+    SAL_TARGET_SSE4 static void load(const T *p, reg_type &v)
+    {
+        v.lo = ops::encode(_mm_loadu_si128((const __m128i *) p));
+        v.hi = ops::encode(_mm_loadu_si128((const __m128i *) &p[4]));
+    }
+
+    SAL_TARGET_SSE4 static void store(T *p, const reg_type &v)
+    {
+        _mm_storeu_si128((__m128i *) p, ops::decode(v.lo));
+        _mm_storeu_si128((__m128i *) &p[4], ops::decode(v.hi));
+    }
+
+    SAL_TARGET_SSE4 static void merge(reg_type &vA, reg_type &vB, reg_type &vMin, reg_type &vMax)
+    {
+        reg_type a = vA, b = vB;
+        merge_8x8_32bit<Order>(a.lo, a.hi, b.lo, b.hi, vMin.lo, vMin.hi, vMax.lo, vMax.hi);
+    }
+};
+#endif
+
+#ifdef _USE_AVX2_
+/*
+ * 64-bit integer lanes. AVX2 has no 64-bit min/max, they are built from cmpgt_epi64 and a blend;
+ * unsigned keys use sign_flip_order.
+ */
+template<>
+struct avx2_64bit_ops<signed_order>
+{
+    SAL_TARGET_AVX2 static __m256i min(const __m256i &a, const __m256i &b)
+    {
+        return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+    }
+
+    SAL_TARGET_AVX2 static __m256i max(const __m256i &a, const __m256i &b)
+    {
+        return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b));
+    }
+
+    SAL_TARGET_AVX2 static __m256i gt(const __m256i &a, const __m256i &b) { return _mm256_cmpgt_epi64(a, b); }
+
+    SAL_TARGET_AVX2 static __m256i encode(const __m256i &v) { return v; }
+    SAL_TARGET_AVX2 static __m256i decode(const __m256i &v) { return v; }
+};
+
+template<>
+struct avx2_64bit_ops<sign_flip_order> : avx2_64bit_ops<signed_order>
+{
+    SAL_TARGET_AVX2 static __m256i encode(const __m256i &v) { return _mm256_xor_si256(v, _mm256_set1_epi64x(INT64_MIN)); }
+    SAL_TARGET_AVX2 static __m256i decode(const __m256i &v) { return encode(v); }
+};
+
+/*
+ * Floating point lanes, NaNs are ordered after all numbers. min(a, b) returns a unless b orders
+ * strictly before it and max(a, b) returns a unless b orders strictly after it, so the networks
+ * below keep every compare-exchange a permutation of its inputs, including -0.0/+0.0 and NaNs.
+ */
+struct avx2_float_ops
+{
+    SAL_TARGET_AVX2 static __m256 is_nan(const __m256 &v) { return _mm256_cmp_ps(v, v, _CMP_UNORD_Q); }
+
+    SAL_TARGET_AVX2 static __m256 min(const __m256 &a, const __m256 &b)
+    {
+        return _mm256_blendv_ps(_mm256_min_ps(b, a), b, _mm256_andnot_ps(is_nan(b), is_nan(a)));
+    }
+
+    SAL_TARGET_AVX2 static __m256 max(const __m256 &a, const __m256 &b)
+    {
+        return _mm256_blendv_ps(_mm256_max_ps(b, a), b, _mm256_andnot_ps(is_nan(a), is_nan(b)));
+    }
+};
+
+struct avx2_double_ops
+{
+    SAL_TARGET_AVX2 static __m256d is_nan(const __m256d &v) { return _mm256_cmp_pd(v, v, _CMP_UNORD_Q); }
+
+    SAL_TARGET_AVX2 static __m256d min(const __m256d &a, const __m256d &b)
+    {
+        return _mm256_blendv_pd(_mm256_min_pd(b, a), b, _mm256_andnot_pd(is_nan(b), is_nan(a)));
+    }
+
+    SAL_TARGET_AVX2 static __m256d max(const __m256d &a, const __m256d &b)
+    {
+        return _mm256_blendv_pd(_mm256_max_pd(b, a), b, _mm256_andnot_pd(is_nan(a), is_nan(b)));
+    }
+};
+
+// Sorts a bitonic sequence of 4 lanes
+template<typename Order>
+SAL_TARGET_AVX2 inline void bitonic_clean_avx2_4x64bit(__m256i &v) {
+    using ops = avx2_64bit_ops<Order>;
+    __m256i vTmp, vLo, vHi;
+
+    //distance 2
+    vTmp = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2));
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = _mm256_blend_epi32(vLo, vHi, 0xF0);
+
+    //distance 1
+    vTmp = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = _mm256_blend_epi32(vLo, vHi, 0xCC);
+}
+
+// Bitonic merge of two sorted 4-lane vectors. Input and output registers may alias.
+template<typename Order>
+SAL_TARGET_AVX2 inline void merge_avx2_4x4_64bit(__m256i &vA, __m256i &vB, // input
+                                                 __m256i &vMin, __m256i &vMax) { // output
+    using ops = avx2_64bit_ops<Order>;
+
+    __m256i vRev = _mm256_permute4x64_epi64(vB, _MM_SHUFFLE(0, 1, 2, 3));
+
+    __m256i vL = ops::min(vA, vRev);
+    __m256i vH = ops::max(vA, vRev);
+
+    bitonic_clean_avx2_4x64bit<Order>(vL);
+    bitonic_clean_avx2_4x64bit<Order>(vH);
+
+    vMin = vL;
+    vMax = vH;
+}
+
+// Bitonic merge of two sorted 8-element sequences held in register pairs
+template<typename Order>
+SAL_TARGET_AVX2 inline void merge_avx2_8x8_64bit(__m256i &vA0, __m256i &vA1, // input 1
+                                                 __m256i &vB0, __m256i &vB1, // input 2
+                                                 __m256i &vMin0, __m256i &vMin1, // output
+                                                 __m256i &vMax0, __m256i &vMax1) { // output
+    using ops = avx2_64bit_ops<Order>;
+
+    __m256i vRev0 = _mm256_permute4x64_epi64(vB1, _MM_SHUFFLE(0, 1, 2, 3));
+    __m256i vRev1 = _mm256_permute4x64_epi64(vB0, _MM_SHUFFLE(0, 1, 2, 3));
+
+    //distance 8
+    __m256i vL0 = ops::min(vA0, vRev0);
+    __m256i vL1 = ops::min(vA1, vRev1);
+    __m256i vH0 = ops::max(vA0, vRev0);
+    __m256i vH1 = ops::max(vA1, vRev1);
+
+    //distance 4
+    __m256i vTmp = vL0;
+    vL0 = ops::min(vTmp, vL1);
+    vL1 = ops::max(vL1, vTmp);
+    vTmp = vH0;
+    vH0 = ops::min(vTmp, vH1);
+    vH1 = ops::max(vH1, vTmp);
+
+    //distance 2 and 1
+    bitonic_clean_avx2_4x64bit<Order>(vL0);
+    bitonic_clean_avx2_4x64bit<Order>(vL1);
+    bitonic_clean_avx2_4x64bit<Order>(vH0);
+    bitonic_clean_avx2_4x64bit<Order>(vH1);
+
+    vMin0 = vL0;
+    vMin1 = vL1;
+    vMax0 = vH0;
+    vMax1 = vH1;
+}
+
+// Sorts a bitonic sequence of 8 float lanes
+SAL_TARGET_AVX2 inline void bitonic_clean_avx2_8xfloat(__m256 &v) {
+    using ops = avx2_float_ops;
+    __m256 vTmp, vLo, vHi;
+
+    //distance 4
+    vTmp = _mm256_permute2f128_ps(v, v, 0x01);
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = _mm256_blend_ps(vLo, vHi, 0xF0);
+
+    //distance 2
+    vTmp = _mm256_permute_ps(v, _MM_SHUFFLE(1, 0, 3, 2));
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = _mm256_blend_ps(vLo, vHi, 0xCC);
+
+    //distance 1
+    vTmp = _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1));
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = _mm256_blend_ps(vLo, vHi, 0xAA);
+}
+
+// Bitonic merge of two sorted 8-lane float vectors. Input and output registers may alias.
+SAL_TARGET_AVX2 inline void merge_avx2_8x8_float(__m256 &vA, __m256 &vB, // input
+                                                 __m256 &vMin, __m256 &vMax) { // output
+    using ops = avx2_float_ops;
+
+    __m256 vRev = _mm256_permutevar8x32_ps(vB, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+
+    //ties go to different sides
+    __m256 vL = ops::min(vA, vRev);
+    __m256 vH = ops::max(vRev, vA);
+
+    bitonic_clean_avx2_8xfloat(vL);
+    bitonic_clean_avx2_8xfloat(vH);
+
+    vMin = vL;
+    vMax = vH;
+}
+
+// Sorts a bitonic sequence of 4 double lanes
+SAL_TARGET_AVX2 inline void bitonic_clean_avx2_4xdouble(__m256d &v) {
+    using ops = avx2_double_ops;
+    __m256d vTmp, vLo, vHi;
+
+    //distance 2
+    vTmp = _mm256_permute2f128_pd(v, v, 0x01);
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = _mm256_blend_pd(vLo, vHi, 0xC);
+
+    //distance 1
+    vTmp = _mm256_permute_pd(v, 0x5);
+    vLo = ops::min(v, vTmp);
+    vHi = ops::max(v, vTmp);
+    v = _mm256_blend_pd(vLo, vHi, 0xA);
+}
+
+// Bitonic merge of two sorted 4-lane double vectors. Input and output registers may alias.
+SAL_TARGET_AVX2 inline void merge_avx2_4x4_double(__m256d &vA, __m256d &vB, // input
+                                                  __m256d &vMin, __m256d &vMax) { // output
+    using ops = avx2_double_ops;
+
+    __m256d vRev = _mm256_permute4x64_pd(vB, _MM_SHUFFLE(0, 1, 2, 3));
+
+    __m256d vL = ops::min(vA, vRev);
+    __m256d vH = ops::max(vRev, vA);
+
+    bitonic_clean_avx2_4xdouble(vL);
+    bitonic_clean_avx2_4xdouble(vH);
+
+    vMin = vL;
+    vMax = vH;
+}
+
+// Bitonic merge of two sorted 8-element double sequences held in register pairs
+SAL_TARGET_AVX2 inline void merge_avx2_8x8_double(__m256d &vA0, __m256d &vA1, // input 1
+                                                  __m256d &vB0, __m256d &vB1, // input 2
+                                                  __m256d &vMin0, __m256d &vMin1, // output
+                                                  __m256d &vMax0, __m256d &vMax1) { // output
+    using ops = avx2_double_ops;
+
+    __m256d vRev0 = _mm256_permute4x64_pd(vB1, _MM_SHUFFLE(0, 1, 2, 3));
+    __m256d vRev1 = _mm256_permute4x64_pd(vB0, _MM_SHUFFLE(0, 1, 2, 3));
+
+    //distance 8
+    __m256d vL0 = ops::min(vA0, vRev0);
+    __m256d vL1 = ops::min(vA1, vRev1);
+    __m256d vH0 = ops::max(vRev0, vA0);
+    __m256d vH1 = ops::max(vRev1, vA1);
+
+    //distance 4
+    __m256d vTmp = vL0;
+    vL0 = ops::min(vTmp, vL1);
+    vL1 = ops::max(vL1, vTmp);
+    vTmp = vH0;
+    vH0 = ops::min(vTmp, vH1);
+    vH1 = ops::max(vH1, vTmp);
+
+    //distance 2 and 1
+    bitonic_clean_avx2_4xdouble(vL0);
+    bitonic_clean_avx2_4xdouble(vL1);
+    bitonic_clean_avx2_4xdouble(vH0);
+    bitonic_clean_avx2_4xdouble(vH1);
+
+    vMin0 = vL0;
+    vMin1 = vL1;
+    vMax0 = vH0;
+    vMax1 = vH1;
+}
+
+template<typename T, typename Order = typename std::conditional<std::is_signed<T>::value,
+                                                                signed_order, sign_flip_order>::type>
+struct avx2_64bit_kernel
+{
+    using value_type = T;
+    struct reg_type { __m256i lo, hi; };
+    using ops = avx2_64bit_ops<Order>;
+    static constexpr size_t width = 8;
+
+    SAL_TARGET_AVX2 static void load(const T *p, reg_type &v)
+    {
+        v.lo = ops::encode(_mm256_loadu_si256((const __m256i *) p));
+        v.hi = ops::encode(_mm256_loadu_si256((const __m256i *) &p[4]));
+    }
+
+    SAL_TARGET_AVX2 static void store(T *p, const reg_type &v)
+    {
+        _mm256_storeu_si256((__m256i *) p, ops::decode(v.lo));
+        _mm256_storeu_si256((__m256i *) &p[4], ops::decode(v.hi));
+    }
+
+    SAL_TARGET_AVX2 static void merge(reg_type &vA, reg_type &vB, reg_type &vMin, reg_type &vMax)
+    {
+        reg_type a = vA, b = vB;
+        merge_avx2_8x8_64bit<Order>(a.lo, a.hi, b.lo, b.hi, vMin.lo, vMin.hi, vMax.lo, vMax.hi);
+    }
+};
+
+struct avx2_float_kernel
+{
+    using value_type = float;
+    using reg_type = __m256;
+    static constexpr size_t width = 8;
+
+    SAL_TARGET_AVX2 static void load(const float *p, reg_type &v) { v = _mm256_loadu_ps(p); }
+    SAL_TARGET_AVX2 static void store(float *p, const reg_type &v) { _mm256_storeu_ps(p, v); }
+
+    SAL_TARGET_AVX2 static void merge(reg_type &vA, reg_type &vB, reg_type &vMin, reg_type &vMax)
+    {
+        merge_avx2_8x8_float(vA, vB, vMin, vMax);
+    }
+};
+
+struct avx2_double_kernel
+{
+    using value_type = double;
+    struct reg_type { __m256d lo, hi; };
+    static constexpr size_t width = 8;
+
+    SAL_TARGET_AVX2 static void load(const double *p, reg_type &v)
+    {
+        v.lo = _mm256_loadu_pd(p);
+        v.hi = _mm256_loadu_pd(&p[4]);
+    }
+
+    SAL_TARGET_AVX2 static void store(double *p, const reg_type &v)
+    {
+        _mm256_storeu_pd(p, v.lo);
+        _mm256_storeu_pd(&p[4], v.hi);
+    }
+
+    SAL_TARGET_AVX2 static void merge(reg_type &vA, reg_type &vB, reg_type &vMin, reg_type &vMax)
+    {
+        reg_type a = vA, b = vB;
+        merge_avx2_8x8_double(a.lo, a.hi, b.lo, b.hi, vMin.lo, vMin.hi, vMax.lo, vMax.hi);
+    }
+};
+
+template<typename T>
+struct avx2_merge_kernel<T, typename std::enable_if<is_int_key<T, 4>::value>::type> {
+    using type = avx2_32bit_kernel<T>;
+};
+
+template<typename T>
+struct avx2_merge_kernel<T, typename std::enable_if<is_int_key<T, 8>::value>::type> {
+    using type = avx2_64bit_kernel<T>;
+};
+
+template<>
+struct avx2_merge_kernel<float> { using type = avx2_float_kernel; };
+
+template<>
+struct avx2_merge_kernel<double> { using type = avx2_double_kernel; };
+#endif
+
+#ifdef _USE_SSE4_
+template<typename T>
+struct sse4_merge_kernel<T, typename std::enable_if<is_int_key<T, 4>::value>::type> {
+    using type = sse4_32bit_kernel<T>;
+};
+#endif
+
+#ifdef _USE_AVX512_
+template<typename T>
+struct avx512_merge_kernel<T, typename std::enable_if<is_int_key<T, 4>::value>::type> {
+    using type = avx512_32bit_kernel<T>;
+};
+#endif
+
+#ifdef _USE_AVX2_
+/*
+ * Key/value networks. Payload lanes follow the keys through the same permutes and blends, driven
+ * by a greater-than mask on the keys. On equal keys every lane keeps its own element, so keys and
+ * payloads stay paired. Unsigned keys use sign_flip_order since only signed cmpgt exists.
+ */
+template<typename K>
+struct by_key_order {
+    using type = typename std::conditional<std::is_signed<K>::value, signed_order, sign_flip_order>::type;
+};
+
+// Sorts a bitonic sequence of 8 key lanes together with their payload lanes
+template<typename Order>
+SAL_TARGET_AVX2 inline void bitonic_clean_avx2_8x32bit_by_key(__m256i &k, __m256i &v) {
+    using ops = avx2_32bit_ops<Order>;
+    __m256i kTmp, vTmp, m;
+
+    //distance 4: lower lanes take the partner when it is smaller, upper lanes when it is greater
+    kTmp = _mm256_permute2x128_si256(k, k, 0x01);
+    vTmp = _mm256_permute2x128_si256(v, v, 0x01);
+    m = _mm256_blend_epi32(ops::gt(k, kTmp), ops::gt(kTmp, k), 0xF0);
+    k = _mm256_blendv_epi8(k, kTmp, m);
+    v = _mm256_blendv_epi8(v, vTmp, m);
+
+    //distance 2
+    kTmp = _mm256_shuffle_epi32(k, _MM_SHUFFLE(1, 0, 3, 2));
+    vTmp = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    m = _mm256_blend_epi32(ops::gt(k, kTmp), ops::gt(kTmp, k), 0xCC);
+    k = _mm256_blendv_epi8(k, kTmp, m);
+    v = _mm256_blendv_epi8(v, vTmp, m);
+
+    //distance 1
+    kTmp = _mm256_shuffle_epi32(k, _MM_SHUFFLE(2, 3, 0, 1));
+    vTmp = _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+    m = _mm256_blend_epi32(ops::gt(k, kTmp), ops::gt(kTmp, k), 0xAA);
+    k = _mm256_blendv_epi8(k, kTmp, m);
+    v = _mm256_blendv_epi8(v, vTmp, m);
+}
+
+// Key/value bitonic merge of two sorted 8-lane vectors. Input and output registers may alias.
+template<typename Order>
+SAL_TARGET_AVX2 inline void merge_avx2_8x8_32bit_by_key(__m256i &kA, __m256i &vA, __m256i &kB, __m256i &vB, // input
+                                                        __m256i &kMin, __m256i &vMin,
+                                                        __m256i &kMax, __m256i &vMax) { // output
+    using ops = avx2_32bit_ops<Order>;
+
+    const __m256i vIdx = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i kRev = _mm256_permutevar8x32_epi32(kB, vIdx);
+    __m256i vRev = _mm256_permutevar8x32_epi32(vB, vIdx);
+
+    __m256i m = ops::gt(kA, kRev);
+    __m256i kL = _mm256_blendv_epi8(kA, kRev, m);
+    __m256i vL = _mm256_blendv_epi8(vA, vRev, m);
+    __m256i kH = _mm256_blendv_epi8(kRev, kA, m);
+    __m256i vH = _mm256_blendv_epi8(vRev, vA, m);
+
+    bitonic_clean_avx2_8x32bit_by_key<Order>(kL, vL);
+    bitonic_clean_avx2_8x32bit_by_key<Order>(kH, vH);
+
+    kMin = kL;
+    vMin = vL;
+    kMax = kH;
+    vMax = vH;
+}
+
+// Sorts a bitonic sequence of 4 64-bit key lanes together with their payload lanes
+template<typename Order>
+SAL_TARGET_AVX2 inline void bitonic_clean_avx2_4x64bit_by_key(__m256i &k, __m256i &v) {
+    using ops = avx2_64bit_ops<Order>;
+    __m256i kTmp, vTmp, m;
+
+    //distance 2
+    kTmp = _mm256_permute4x64_epi64(k, _MM_SHUFFLE(1, 0, 3, 2));
+    vTmp = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2));
+    m = _mm256_blend_epi32(ops::gt(k, kTmp), ops::gt(kTmp, k), 0xF0);
+    k = _mm256_blendv_epi8(k, kTmp, m);
+    v = _mm256_blendv_epi8(v, vTmp, m);
+
+    //distance 1
+    kTmp = _mm256_shuffle_epi32(k, _MM_SHUFFLE(1, 0, 3, 2));
+    vTmp = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    m = _mm256_blend_epi32(ops::gt(k, kTmp), ops::gt(kTmp, k), 0xCC);
+    k = _mm256_blendv_epi8(k, kTmp, m);
+    v = _mm256_blendv_epi8(v, vTmp, m);
+}
+
+// Lane-wise compare-exchange of two register pairs, lanes of A keep their element on equal keys
+template<typename Order>
+SAL_TARGET_AVX2 inline void compare_exchange_avx2_64bit_by_key(__m256i &kA, __m256i &vA, __m256i &kB, __m256i &vB) {
+    using ops = avx2_64bit_ops<Order>;
+
+    __m256i m = ops::gt(kA, kB);
+    __m256i kL = _mm256_blendv_epi8(kA, kB, m);
+    __m256i vL = _mm256_blendv_epi8(vA, vB, m);
+    kB = _mm256_blendv_epi8(kB, kA, m);
+    vB = _mm256_blendv_epi8(vB, vA, m);
+    kA = kL;
+    vA = vL;
+}
+
+// Key/value bitonic merge of two sorted 8-element sequences held in register pairs
+template<typename Order>
+SAL_TARGET_AVX2 inline void merge_avx2_8x8_64bit_by_key(__m256i (&kA)[2], __m256i (&vA)[2],
+                                                        __m256i (&kB)[2], __m256i (&vB)[2], // input
+                                                        __m256i (&kMin)[2], __m256i (&vMin)[2],
+                                                        __m256i (&kMax)[2], __m256i (&vMax)[2]) { // output
+    __m256i kL0 = kA[0], vL0 = vA[0], kL1 = kA[1], vL1 = vA[1];
+    __m256i kH0 = _mm256_permute4x64_epi64(kB[1], _MM_SHUFFLE(0, 1, 2, 3));
+    __m256i vH0 = _mm256_permute4x64_epi64(vB[1], _MM_SHUFFLE(0, 1, 2, 3));
+    __m256i kH1 = _mm256_permute4x64_epi64(kB[0], _MM_SHUFFLE(0, 1, 2, 3));
+    __m256i vH1 = _mm256_permute4x64_epi64(vB[0], _MM_SHUFFLE(0, 1, 2, 3));
+
+    //distance 8
+    compare_exchange_avx2_64bit_by_key<Order>(kL0, vL0, kH0, vH0);
+    compare_exchange_avx2_64bit_by_key<Order>(kL1, vL1, kH1, vH1);
+
+    //distance 4
+    compare_exchange_avx2_64bit_by_key<Order>(kL0, vL0, kL1, vL1);
+    compare_exchange_avx2_64bit_by_key<Order>(kH0, vH0, kH1, vH1);
+
+    //distance 2 and 1
+    bitonic_clean_avx2_4x64bit_by_key<Order>(kL0, vL0);
+    bitonic_clean_avx2_4x64bit_by_key<Order>(kL1, vL1);
+    bitonic_clean_avx2_4x64bit_by_key<Order>(kH0, vH0);
+    bitonic_clean_avx2_4x64bit_by_key<Order>(kH1, vH1);
+
+    kMin[0] = kL0; vMin[0] = vL0; kMin[1] = kL1; vMin[1] = vL1;
+    kMax[0] = kH0; vMax[0] = vH0; kMax[1] = kH1; vMax[1] = vH1;
+}
+
+template<typename K, typename V, typename Order = typename by_key_order<K>::type>
+struct avx2_32bit_by_key_kernel
+{
+    using key_type = K;
+    using value_type = V;
+    using reg_type = __m256i;
+    using ops = avx2_32bit_ops<Order>;
+    static constexpr size_t width = 8;
+
+    SAL_TARGET_AVX2 static void load(const K *pk, const V *pv, reg_type &k, reg_type &v)
+    {
+        k = ops::encode(_mm256_loadu_si256((const __m256i *) pk));
+        v = _mm256_loadu_si256((const __m256i *) pv);
+    }
+
+    SAL_TARGET_AVX2 static void store(K *pk, V *pv, const reg_type &k, const reg_type &v)
+    {
+        _mm256_storeu_si256((__m256i *) pk, ops::decode(k));
+        _mm256_storeu_si256((__m256i *) pv, v);
+    }
+
+    SAL_TARGET_AVX2 static void merge(reg_type &kA, reg_type &vA, reg_type &kB, reg_type &vB,
+                                      reg_type &kMin, reg_type &vMin, reg_type &kMax, reg_type &vMax)
+    {
+        merge_avx2_8x8_32bit_by_key<Order>(kA, vA, kB, vB, kMin, vMin, kMax, vMax);
+    }
+};
+
+template<typename K, typename V, typename Order = typename by_key_order<K>::type>
+struct avx2_64bit_by_key_kernel
+{
+    using key_type = K;
+    using value_type = V;
+    struct reg_type { __m256i r[2]; };
+    using ops = avx2_64bit_ops<Order>;
+    static constexpr size_t width = 8;
+
+    SAL_TARGET_AVX2 static void load(const K *pk, const V *pv, reg_type &k, reg_type &v)
+    {
+        k.r[0] = ops::encode(_mm256_loadu_si256((const __m256i *) pk));
+        k.r[1] = ops::encode(_mm256_loadu_si256((const __m256i *) &pk[4]));
+        v.r[0] = _mm256_loadu_si256((const __m256i *) pv);
+        v.r[1] = _mm256_loadu_si256((const __m256i *) &pv[4]);
+    }
+
+    SAL_TARGET_AVX2 static void store(K *pk, V *pv, const reg_type &k, const reg_type &v)
+    {
+        _mm256_storeu_si256((__m256i *) pk, ops::decode(k.r[0]));
+        _mm256_storeu_si256((__m256i *) &pk[4], ops::decode(k.r[1]));
+        _mm256_storeu_si256((__m256i *) pv, v.r[0]);
+        _mm256_storeu_si256((__m256i *) &pv[4], v.r[1]);
+    }
+
+    SAL_TARGET_AVX2 static void merge(reg_type &kA, reg_type &vA, reg_type &kB, reg_type &vB,
+                                      reg_type &kMin, reg_type &vMin, reg_type &kMax, reg_type &vMax)
+    {
+        merge_avx2_8x8_64bit_by_key<Order>(kA.r, vA.r, kB.r, vB.r, kMin.r, vMin.r, kMax.r, vMax.r);
+    }
+};
+
+template<typename K, typename V>
+struct avx2_merge_by_key_kernel<K, V, typename std::enable_if<is_int_key<K, 4>::value && sizeof(V) == 4>::type> {
+    using type = avx2_32bit_by_key_kernel<K, V>;
+};
+
+template<typename K, typename V>
+struct avx2_merge_by_key_kernel<K, V, typename std::enable_if<is_int_key<K, 8>::value && sizeof(V) == 8>::type> {
+    using type = avx2_64bit_by_key_kernel<K, V>;
+};
+#endif
+
+template<typename Kernel>
+inline void streaming_merge(const typename Kernel::value_type *first1, const typename Kernel::value_type *last1,
+                            const typename Kernel::value_type *first2, const typename Kernel::value_type *last2,
+                            typename Kernel::value_type *res)
+{
+    using T = typename Kernel::value_type;
+    using reg_type = typename Kernel::reg_type;
+    constexpr std::ptrdiff_t W = Kernel::width;
+    auto less = [](const T &a, const T &b) { return key_less(a, b); };
+
+    if (last1 - first1 < W || last2 - first2 < W) {
+        std::merge(first1, last1, first2, last2, res, less);
+        return;
+    }
+
+    reg_type vA, vB, vMin, vMax;
+    Kernel::load(first1, vA);
+    Kernel::load(first2, vB);
+    first1 += W;
+    first2 += W;
+
+    Kernel::merge(vA, vB, vMin, vMax);
+    Kernel::store(res, vMin);
+    res += W;
+
+    //vMax is the carry: every element already written is not greater than it or than the unread input
+    while (last1 - first1 >= W && last2 - first2 >= W) {
+        const bool take1 = key_less(*first1, *first2);
+        const T *next = take1 ? first1 : first2;
+        first1 += take1 ? W : 0;
+        first2 += take1 ? 0 : W;
+
+        Kernel::load(next, vA);
+        Kernel::merge(vA, vMax, vMin, vMax);
+        Kernel::store(res, vMin);
+        res += W;
+    }
+
+    //at least one input has less than W elements left, fold it together with the carry first
+    if (last1 - first1 >= W) {
+        std::swap(first1, first2);
+        std::swap(last1, last2);
+    }
+
+    T carry[W];
+    T tail[2 * W];
+    Kernel::store(carry, vMax);
+    T *tail_end = std::merge(carry, carry + W, first1, last1, tail, less);
+    std::merge(tail, tail_end, first2, last2, res, less);
+}
+
+template<typename Kernel>
+inline void streaming_merge_by_key(const typename Kernel::key_type *first1, const typename Kernel::key_type *last1,
+                                   const typename Kernel::value_type *values1,
+                                   const typename Kernel::key_type *first2, const typename Kernel::key_type *last2,
+                                   const typename Kernel::value_type *values2,
+                                   typename Kernel::key_type *res, typename Kernel::value_type *res_values)
+{
+    using K = typename Kernel::key_type;
+    using V = typename Kernel::value_type;
+    using reg_type = typename Kernel::reg_type;
+    constexpr std::ptrdiff_t W = Kernel::width;
+    auto less = [](const K &a, const K &b) { return key_less(a, b); };
+
+    if (last1 - first1 < W || last2 - first2 < W) {
+        merge_by_key(first1, last1, values1, first2, last2, values2, res, res_values, less);
+        return;
+    }
+
+    reg_type kA, vA, kB, vB, kMin, vMin, kMax, vMax;
+    Kernel::load(first1, values1, kA, vA);
+    Kernel::load(first2, values2, kB, vB);
+    first1 += W;
+    values1 += W;
+    first2 += W;
+    values2 += W;
+
+    Kernel::merge(kA, vA, kB, vB, kMin, vMin, kMax, vMax);
+    Kernel::store(res, res_values, kMin, vMin);
+    res += W;
+    res_values += W;
+
+    while (last1 - first1 >= W && last2 - first2 >= W) {
+        const bool take1 = key_less(*first1, *first2);
+        const K *next = take1 ? first1 : first2;
+        const V *next_values = take1 ? values1 : values2;
+        first1 += take1 ? W : 0;
+        values1 += take1 ? W : 0;
+        first2 += take1 ? 0 : W;
+        values2 += take1 ? 0 : W;
+
+        Kernel::load(next, next_values, kA, vA);
+        Kernel::merge(kA, vA, kMax, vMax, kMin, vMin, kMax, vMax);
+        Kernel::store(res, res_values, kMin, vMin);
+        res += W;
+        res_values += W;
+    }
+
+    if (last1 - first1 >= W) {
+        std::swap(first1, first2);
+        std::swap(last1, last2);
+        std::swap(values1, values2);
+    }
+
+    K carry[W];
+    V carry_values[W];
+    K tail[2 * W];
+    V tail_values[2 * W];
+    Kernel::store(carry, carry_values, kMax, vMax);
+    const K *carry_first = carry, *tail_first = tail;
+    const V *carry_first_values = carry_values, *tail_first_values = tail_values;
+    K *tail_end = merge_by_key(carry_first, carry_first + W, carry_first_values, first1, last1, values1,
+                               tail, tail_values, less);
+    merge_by_key(tail_first, static_cast<const K *>(tail_end), tail_first_values, first2, last2, values2,
+                 res, res_values, less);
+}
+
+template<typename T>
+using simd_merge_fn = void (*)(const T *, const T *, const T *, const T *, T *);
+
+// One entry point per tier. Flattening pulls the generic loop and the kernel into a single
+// function compiled for that tier.
+#ifdef _USE_AVX512_
+template<typename Kernel>
+SAL_TARGET_AVX512 SAL_FLATTEN inline void
+avx512_simd_merge(const typename Kernel::value_type *first1, const typename Kernel::value_type *last1,
+                  const typename Kernel::value_type *first2, const typename Kernel::value_type *last2,
+                  typename Kernel::value_type *res)
+{
+    streaming_merge<Kernel>(first1, last1, first2, last2, res);
+}
+#endif
+
+#ifdef _USE_AVX2_
+template<typename Kernel>
+SAL_TARGET_AVX2 SAL_FLATTEN inline void
+avx2_simd_merge(const typename Kernel::value_type *first1, const typename Kernel::value_type *last1,
+                const typename Kernel::value_type *first2, const typename Kernel::value_type *last2,
+                typename Kernel::value_type *res)
+{
+    streaming_merge<Kernel>(first1, last1, first2, last2, res);
+}
+#endif
+
+#ifdef _USE_SSE4_
+template<typename Kernel>
+SAL_TARGET_SSE4 SAL_FLATTEN inline void
+sse4_simd_merge(const typename Kernel::value_type *first1, const typename Kernel::value_type *last1,
+                const typename Kernel::value_type *first2, const typename Kernel::value_type *last2,
+                typename Kernel::value_type *res)
+{
+    streaming_merge<Kernel>(first1, last1, first2, last2, res);
+}
+#endif
+
+template<typename T>
+inline void
+scalar_merge(const T *first1, const T *last1, const T *first2, const T *last2, T *res)
+{
+    std::merge(first1, last1, first2, last2, res, [](const T &a, const T &b) { return key_less(a, b); });
+}
+
+// Entry point of a tier for key type T, nullptr when the tier has no kernel for it
+template<typename T, typename Kernel>
+struct tier_merge
+{
+#ifdef _USE_AVX512_
+    static simd_merge_fn<T> avx512() { return &avx512_simd_merge<Kernel>; }
+#endif
+#ifdef _USE_AVX2_
+    static simd_merge_fn<T> avx2() { return &avx2_simd_merge<Kernel>; }
+#endif
+#ifdef _USE_SSE4_
+    static simd_merge_fn<T> sse4() { return &sse4_simd_merge<Kernel>; }
+#endif
+};
+
+template<typename T>
+struct tier_merge<T, void>
+{
+    static simd_merge_fn<T> avx512() { return nullptr; }
+    static simd_merge_fn<T> avx2() { return nullptr; }
+    static simd_merge_fn<T> sse4() { return nullptr; }
+};
+
+// Best kernel not above the given tier. A tier without a kernel for T falls through to the next one.
+template<typename T>
+inline simd_merge_fn<T> select_simd_merge(dispatch::simd_level level)
+{
+    simd_merge_fn<T> fn = nullptr;
+#ifdef _USE_AVX512_
+    if (!fn && level >= dispatch::simd_level::avx512)
+        fn = tier_merge<T, typename avx512_merge_kernel<T>::type>::avx512();
+#endif
+#ifdef _USE_AVX2_
+    if (!fn && level >= dispatch::simd_level::avx2)
+        fn = tier_merge<T, typename avx2_merge_kernel<T>::type>::avx2();
+#endif
+#ifdef _USE_SSE4_
+    if (!fn && level >= dispatch::simd_level::sse4)
+        fn = tier_merge<T, typename sse4_merge_kernel<T>::type>::sse4();
+#endif
+    (void)level;
+    return fn ? fn : &scalar_merge<T>;
+}
+
+template<typename K, typename V>
+using simd_merge_by_key_fn = void (*)(const K *, const K *, const V *, const K *, const K *, const V *, K *, V *);
+
+#ifdef _USE_AVX2_
+template<typename Kernel>
+SAL_TARGET_AVX2 SAL_FLATTEN inline void
+avx2_simd_merge_by_key(const typename Kernel::key_type *first1, const typename Kernel::key_type *last1,
+                       const typename Kernel::value_type *values1,
+                       const typename Kernel::key_type *first2, const typename Kernel::key_type *last2,
+                       const typename Kernel::value_type *values2,
+                       typename Kernel::key_type *res, typename Kernel::value_type *res_values)
+{
+    streaming_merge_by_key<Kernel>(first1, last1, values1, first2, last2, values2, res, res_values);
+}
+#endif
+
+template<typename K, typename V>
+inline void
+scalar_merge_by_key(const K *first1, const K *last1, const V *values1,
+                    const K *first2, const K *last2, const V *values2, K *res, V *res_values)
+{
+    merge_by_key(first1, last1, values1, first2, last2, values2, res, res_values,
+                 [](const K &a, const K &b) { return key_less(a, b); });
+}
+
+template<typename K, typename V, typename Kernel>
+struct tier_merge_by_key
+{
+#ifdef _USE_AVX2_
+    static simd_merge_by_key_fn<K, V> avx2() { return &avx2_simd_merge_by_key<Kernel>; }
+#endif
+};
+
+template<typename K, typename V>
+struct tier_merge_by_key<K, V, void>
+{
+    static simd_merge_by_key_fn<K, V> avx2() { return nullptr; }
+};
+
+// Key/value kernels exist for AVX2, higher tiers use them and lower tiers run the scalar merge
+template<typename K, typename V>
+inline simd_merge_by_key_fn<K, V> select_simd_merge_by_key(dispatch::simd_level level)
+{
+    simd_merge_by_key_fn<K, V> fn = nullptr;
+#ifdef _USE_AVX2_
+    if (level >= dispatch::simd_level::avx2)
+        fn = tier_merge_by_key<K, V, typename avx2_merge_by_key_kernel<K, V>::type>::avx2();
+#endif
+    (void)level;
+    return fn ? fn : &scalar_merge_by_key<K, V>;
+}
+
+}
+
+template<typename T>
+inline void
+sequential_simd_merge(const T *first1, const T *last1, const T *first2, const T *last2, T *res)
+{
+    static const kernel::simd_merge_fn<T> merge_fn = kernel::select_simd_merge<T>(dispatch::active_simd_level());
+
+    merge_fn(first1, last1, first2, last2, res);
+}
+
+template<typename K, typename V>
+inline void
+sequential_simd_merge_by_key(const K *first1, const K *last1, const V *values1,
+                             const K *first2, const K *last2, const V *values2, K *res, V *res_values)
+{
+    static const kernel::simd_merge_by_key_fn<K, V> merge_fn =
+            kernel::select_simd_merge_by_key<K, V>(dispatch::active_simd_level());
+
+    merge_fn(first1, last1, values1, first2, last2, values2, res, res_values);
 }
 
 }}}
 
-#endif
\ No newline at end of file
+#endif
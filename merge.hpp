@@ -7,9 +7,12 @@
 
 
 #include <cmath>
-#include <tbb/tbb.h>
 #include <immintrin.h>
 #include "utility.hpp"
+#include "async.hpp"
+#include "tuning.hpp"
+#include "perf.hpp"
+#include "stats.hpp"
 
 namespace sal {
 namespace merge {
@@ -19,11 +22,11 @@ using utils::serial_invoker;
 using utils::binary_search;
 using utils::is_random_access_iterator;
 
+// Fixed split, tuned_block_partition derives the block from the host caches and the element type
 struct auto_block_partition
 {
     size_t operator()(size_t arr_size)
     {
-        //TODO
         return std::max((size_t)8192, arr_size / 8);
     }
 };
@@ -46,23 +49,175 @@ struct static_block_partition
     }
 };
 
+/**
+ * Merge-path partition: instead of a block size for the divide-and-conquer split, returns the
+ * number of equal output diagonals. The split point of every diagonal is found directly by a
+ * co-rank search and the pieces are merged by independent tasks, a flat tbb::parallel_for under
+ * parallel_invoker and a halving split on the merger's Invoker otherwise.
+ * Parts = 0 uses four pieces per thread of the merger's Invoker. Pieces are never smaller than 8192 keys.
+ */
+template<size_t Parts = 0>
+struct merge_path_partition
+{
+    size_t operator()(size_t arr_size, size_t threads)
+    {
+        size_t parts = Parts ? Parts : 4 * threads;
+        return std::max((size_t)1, std::min(parts, arr_size / 8192));
+    }
+
+    size_t operator()(size_t arr_size)
+    {
+        return (*this)(arr_size, utils::concurrency(parallel_invoker()));
+    }
+};
+
+template<typename BlockPartition>
+struct is_merge_path_partition : std::false_type {};
+
+template<size_t Parts>
+struct is_merge_path_partition<merge_path_partition<Parts>> : std::true_type {};
+
+namespace internal {
+
+template<typename BlockPartition, typename Invoker>
+auto partition(size_t n, const Invoker &invoker, int) -> decltype(BlockPartition()(n, n))
+{
+    return BlockPartition()(n, utils::concurrency(invoker));
+}
+
+template<typename BlockPartition, typename Invoker>
+size_t partition(size_t n, const Invoker &, long)
+{
+    return BlockPartition()(n);
+}
+
+}
+
+// Value of BlockPartition for n keys merged on invoker, partitions taking a thread count get the threads of invoker
+template<typename BlockPartition, typename Invoker>
+size_t partition(size_t n, const Invoker &invoker)
+{
+    return internal::partition<BlockPartition>(n, invoker, 0);
+}
+
+namespace internal {
+
+namespace kernel {
+
+// Order used by the kernels and their scalar tails. Floating point keys order NaNs after all numbers.
+template<typename T>
+inline bool key_less(const T &a, const T &b) { return a < b; }
+
+inline bool key_less(const float &a, const float &b) { return a < b || (a == a && b != b); }
+
+inline bool key_less(const double &a, const double &b) { return a < b || (a == a && b != b); }
+
+}
+
+template<typename T>
+struct nan_last_less {
+    bool operator()(const T &a, const T &b) const { return kernel::key_less(a, b); }
+};
+
+/**
+ * Comparator of the scalar sorts, merges and searches. std::less of float and double becomes
+ * the kernel order, so every entry point puts NaNs after all numbers like the vector kernels do
+ * and std::sort gets a strict weak order; other comparators are used as they are.
+ */
+template<typename Comparator>
+inline Comparator scalar_order(Comparator cmp) { return cmp; }
+
+inline nan_last_less<float> scalar_order(std::less<float>) { return nan_last_less<float>(); }
+
+inline nan_last_less<double> scalar_order(std::less<double>) { return nan_last_less<double>(); }
+
+// std::merge over a key range and a parallel payload range, returns the end of the output keys
+template<typename InputIterator, typename ValueInputIterator, typename OutputIterator, typename ValueOutputIterator,
+         typename Comparator>
+OutputIterator merge_by_key(InputIterator first1, InputIterator last1, ValueInputIterator values1,
+                            InputIterator first2, InputIterator last2, ValueInputIterator values2,
+                            OutputIterator out, ValueOutputIterator out_values, Comparator cmp) {
+    auto order = scalar_order(cmp);
+    while (first1 != last1 && first2 != last2) {
+        if (order(*first2, *first1)) {
+            *out = *first2;
+            *out_values = *values2;
+            ++first2;
+            ++values2;
+        }
+        else {
+            *out = *first1;
+            *out_values = *values1;
+            ++first1;
+            ++values1;
+        }
+        ++out;
+        ++out_values;
+    }
+
+    out_values = std::copy(values1, values1 + std::distance(first1, last1), out_values);
+    out = std::copy(first1, last1, out);
+    std::copy(values2, values2 + std::distance(first2, last2), out_values);
+    return std::copy(first2, last2, out);
+}
+
+/**
+ * Co-rank of output position d in the stable merge of a[0, n1) and b[0, n2): the number of keys
+ * taken from a among the first d outputs, equal keys of a going first. Binary search on the
+ * diagonal d of the merge path.
+ */
+template<typename T, typename Comparator>
+long long co_rank(long long d, const T *a, long long n1, const T *b, long long n2, Comparator cmp) {
+    auto order = scalar_order(cmp);
+    long long lo = std::max(0LL, d - n2);
+    long long hi = std::min(d, n1);
+
+    while (lo < hi) {
+        long long i = lo + (hi - lo) / 2;
+        long long j = d - i;
+
+        //b[j-1] must order strictly before a[i]
+        if (j > 0 && i < n1 && !order(b[j - 1], a[i]))
+            lo = i + 1;
+        else
+            hi = i;
+    }
+
+    return lo;
+}
+
+}
+
 struct default_merger {
     template<typename InputIterator, typename OutputIterator, typename Comparator>
     void operator()(InputIterator first1, InputIterator last1, InputIterator first2, InputIterator last2,
                     OutputIterator out, Comparator cmp) {
-        std::merge(first1, last1, first2, last2, out, cmp);
+        std::merge(first1, last1, first2, last2, out, internal::scalar_order(cmp));
+    }
+
+    template<typename InputIterator, typename ValueInputIterator, typename OutputIterator, typename ValueOutputIterator,
+             typename Comparator>
+    void operator()(InputIterator first1, InputIterator last1, ValueInputIterator values1,
+                    InputIterator first2, InputIterator last2, ValueInputIterator values2,
+                    OutputIterator out, ValueOutputIterator out_values, Comparator cmp) {
+        internal::merge_by_key(first1, last1, values1, first2, last2, values2, out, out_values, cmp);
     }
 };
 
-template<typename T, typename Invoker = parallel_invoker, typename BlockMerger = default_merger, typename BlockPartition = auto_block_partition>
+// Stats is a policy of stats.hpp that gets the task counts, merge block sizes, search probes and
+// BlockMerger times of every merge, see sorter for the sort side
+template<typename T, typename Invoker = parallel_invoker, typename BlockMerger = default_merger, typename BlockPartition = auto_block_partition,
+         typename Stats = stats::no_stats>
 class merger {
 public:
 
     merger() = delete;
 
+    // invoker carries the task cutoff of a caller that is itself a parallel recursion, see cutoff_invoker
     template<typename Comparator = std::less<T>>
     static void merge(const T* src1, long long p1, long long r1,
-                      long long p2, long long r2, T* dest, long long p3, Comparator cmp = Comparator());
+                      long long p2, long long r2, T* dest, long long p3, Comparator cmp = Comparator(),
+                      Invoker invoker = Invoker());
 
     template<typename Comparator = std::less<T>>
     static void merge(const T* src1, long long p1, long long r1,
@@ -76,20 +231,70 @@ public:
     static void merge(InputIterator first1, InputIterator last1, InputIterator first2, InputIterator last2,
                       OutputIterator out, Comparator cmp = Comparator());
 
+    // Key/value merges: the payload arrays run parallel to the keys and are reordered with them.
+    // Equal keys are not guaranteed to keep their input order.
+    template<typename V, typename Comparator = std::less<T>>
+    static void merge_by_key(const T* src1, const V* values1, long long p1, long long r1,
+                             long long p2, long long r2, T* dest, V* dest_values, long long p3,
+                             Comparator cmp = Comparator(), Invoker invoker = Invoker());
+
+    template<typename InputIterator, typename ValueInputIterator, typename OutputIterator,
+             typename ValueOutputIterator, typename Comparator = std::less<T>>
+    static void merge_by_key(InputIterator first1, InputIterator last1, ValueInputIterator values1,
+                             InputIterator first2, InputIterator last2, ValueInputIterator values2,
+                             OutputIterator out, ValueOutputIterator out_values, Comparator cmp = Comparator());
+
+    // merge in the background on the scheduler of Invoker (its pool for pool_invoker, TBB otherwise), one
+    // phase; the ranges must stay valid until the handle is ready
+    template<typename InputIterator, typename OutputIterator, typename Comparator = std::less<T>>
+    static async::handle merge_async(InputIterator first1, InputIterator last1, InputIterator first2, InputIterator last2,
+                                     OutputIterator out, Comparator cmp = Comparator());
+
 
 private:
+    // Splits the merge as chosen by BlockPartition and runs the pieces through BlockMerger
+    template<typename Comparator>
+    static void _partitioned_merge(const T *t, long long p1, long long r1,
+                                   const T *t2, long long p2, long long r2,
+                                   T *a, long long p3, Comparator cmp, Invoker invoker = Invoker());
+
+    template<typename V, typename Comparator>
+    static void _partitioned_merge_by_key(const T *t, const V *v, long long p1, long long r1,
+                                          const T *t2, const V *v2, long long p2, long long r2,
+                                          T *a, V *av, long long p3, Comparator cmp, Invoker invoker = Invoker());
+
+    template<typename Comparator>
+    static void _merge_path(const T *t, long long p1, long long r1,
+                            const T *t2, long long p2, long long r2,
+                            T *a, long long p3, Comparator cmp, size_t parts, BlockMerger block_merger,
+                            Invoker invoker);
+
+    template<typename V, typename Comparator>
+    static void _merge_path_by_key(const T *t, const V *v, long long p1, long long r1,
+                                   const T *t2, const V *v2, long long p2, long long r2,
+                                   T *a, V *av, long long p3, Comparator cmp, size_t parts,
+                                   BlockMerger block_merger, Invoker invoker);
+
     template<typename Comparator>
     static void _dac_merge(const T *t, long long p1, long long r1,
                     const T *t2, long long p2, long long r2,
-                    T *a, long long p3, Comparator cmp, size_t block_size, BlockMerger block_merger, Invoker invoker = Invoker());
+                    T *a, long long p3, Comparator cmp, size_t block_size, BlockMerger block_merger, Invoker invoker = Invoker(),
+                    unsigned depth = 0);
+
+    template<typename V, typename Comparator>
+    static void _dac_merge_by_key(const T *t, const V *v, long long p1, long long r1,
+                                  const T *t2, const V *v2, long long p2, long long r2,
+                                  T *a, V *av, long long p3, Comparator cmp, size_t block_size,
+                                  BlockMerger block_merger, Invoker invoker = Invoker(), unsigned depth = 0);
 
 };
 
 
-template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition>
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
 template<typename Comparator>
-void merger<T, Invoker, BlockMerger, BlockPartition>::merge(const T* src1, long long p1, long long r1,
-                                                   long long p2, long long r2, T* dest, long long p3, Comparator cmp)
+void merger<T, Invoker, BlockMerger, BlockPartition, Stats>::merge(const T* src1, long long p1, long long r1,
+                                                   long long p2, long long r2, T* dest, long long p3, Comparator cmp,
+                                                   Invoker invoker)
 {
     long long n1 = r1 - p1 + 1;
     long long n2 = r2 - p2 + 1;
@@ -98,27 +303,21 @@ void merger<T, Invoker, BlockMerger, BlockPartition>::merge(const T* src1, long
     if(n12 == 0)
         return;
 
-    size_t block_size = BlockPartition()(n12);
-
-    _dac_merge(src1, p1, r1, src1, p2, r2, dest, p3, cmp, block_size, BlockMerger());
+    _partitioned_merge(src1, p1, r1, src1, p2, r2, dest, p3, cmp, invoker);
 }
 
-template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition>
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
 template<typename Comparator>
-void merger<T, Invoker, BlockMerger, BlockPartition>::merge(const T* src1, long long p1, long long r1,
+void merger<T, Invoker, BlockMerger, BlockPartition, Stats>::merge(const T* src1, long long p1, long long r1,
                                                    const T* src2, long long p2, long long r2,
                                                    T* dest, long long p3, Comparator cmp)
 {
-    long long n1 = r1 - p1 + 1;
-    long long n2 = r2 - p2 + 1;
-    size_t block_size = BlockPartition()(n1+n2);
-
-    _dac_merge(src1, p1, r1, src2, p2, r2, dest, p3, cmp, block_size, BlockMerger());
+    _partitioned_merge(src1, p1, r1, src2, p2, r2, dest, p3, cmp);
 }
 
-template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition>
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
 template<typename InputIterator, typename OutputIterator, typename Comparator>
-void merger<T, Invoker, BlockMerger, BlockPartition>::merge(InputIterator first, InputIterator mid, InputIterator last,
+void merger<T, Invoker, BlockMerger, BlockPartition, Stats>::merge(InputIterator first, InputIterator mid, InputIterator last,
                                                             OutputIterator out, Comparator cmp)
 {
     static_assert(std::is_same<T, typename std::iterator_traits<InputIterator>::value_type>::value,
@@ -129,19 +328,17 @@ void merger<T, Invoker, BlockMerger, BlockPartition>::merge(InputIterator first,
     long long a_size = std::distance(first, mid);
     long long b_size = std::distance(mid, last);
 
-    size_t block_size = BlockPartition()(a_size+b_size);
-
     long long p1 = 0, r1 = a_size-1 , p2 = 0, r2 = b_size-1 , p3 = 0;
     auto t = utils::iterator2pointer(first);
     auto t2 = utils::iterator2pointer(mid);
     auto outp = utils::iterator2pointer(out);
 
-    _dac_merge(t, p1, r1, t2, p2, r2, outp, p3, cmp, block_size, BlockMerger());
+    _partitioned_merge(t, p1, r1, t2, p2, r2, outp, p3, cmp);
 };
 
-template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition>
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
 template<typename InputIterator, typename OutputIterator, typename Comparator>
-void merger<T, Invoker, BlockMerger, BlockPartition>::merge(InputIterator first1, InputIterator last1, InputIterator first2,
+void merger<T, Invoker, BlockMerger, BlockPartition, Stats>::merge(InputIterator first1, InputIterator last1, InputIterator first2,
                                                    InputIterator last2, OutputIterator out, Comparator cmp) {
 
     static_assert(std::is_same<T, typename std::iterator_traits<InputIterator>::value_type>::value,
@@ -152,125 +349,206 @@ void merger<T, Invoker, BlockMerger, BlockPartition>::merge(InputIterator first1
     long long a_size = std::distance(first1, last1);
     long long b_size = std::distance(first2, last2);
 
-    size_t block_size = BlockPartition()(a_size+b_size);
-
     long long p1 = 0, r1 = a_size-1 , p2 = 0, r2 = b_size-1 , p3 = 0;
     auto t = utils::iterator2pointer(first1);
     auto t2 = utils::iterator2pointer(first2);
     auto outp = utils::iterator2pointer(out);
 
-    _dac_merge(t, p1, r1, t2, p2, r2, outp, p3, cmp, block_size, BlockMerger());
+    _partitioned_merge(t, p1, r1, t2, p2, r2, outp, p3, cmp);
 }
 
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
+template<typename V, typename Comparator>
+void merger<T, Invoker, BlockMerger, BlockPartition, Stats>::merge_by_key(const T* src1, const V* values1, long long p1, long long r1,
+                                                                   long long p2, long long r2, T* dest, V* dest_values,
+                                                                   long long p3, Comparator cmp, Invoker invoker)
+{
+    long long n1 = r1 - p1 + 1;
+    long long n2 = r2 - p2 + 1;
+    long long n12 = n1+n2;
 
-namespace internal {
+    if(n12 == 0)
+        return;
 
-namespace kernel {
+    _partitioned_merge_by_key(src1, values1, p1, r1, src1, values1, p2, r2, dest, dest_values, p3, cmp, invoker);
+}
 
-#ifdef _USE_AVX2_
-inline void merge_avx2_8x8_32bit(__m256i &vA, __m256i &vB,
-                                 __m256i &vMin, __m256i &vMax);
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
+template<typename InputIterator, typename ValueInputIterator, typename OutputIterator,
+         typename ValueOutputIterator, typename Comparator>
+void merger<T, Invoker, BlockMerger, BlockPartition, Stats>::merge_by_key(InputIterator first1, InputIterator last1,
+                                                                   ValueInputIterator values1,
+                                                                   InputIterator first2, InputIterator last2,
+                                                                   ValueInputIterator values2,
+                                                                   OutputIterator out, ValueOutputIterator out_values,
+                                                                   Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<InputIterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<InputIterator>::value && is_random_access_iterator<OutputIterator>::value &&
+                  is_random_access_iterator<ValueInputIterator>::value && is_random_access_iterator<ValueOutputIterator>::value,
+                  "Iterators must be of random-access iterator type");
 
-inline void merge_256i(const int *a, const int *b, int *res);
-#endif
-#ifdef _USE_SSE4_
-inline void merge_8x8_128i(const int *a, const int *b, int *res);
-#endif
+    long long a_size = std::distance(first1, last1);
+    long long b_size = std::distance(first2, last2);
 
-inline void merge_8x8_debug(const int* a, const int* b, int* res)
-{
-    std::merge(a, a+8, b, b+8, res);
+    long long p1 = 0, r1 = a_size-1 , p2 = 0, r2 = b_size-1 , p3 = 0;
+    auto t = utils::iterator2pointer(first1);
+    auto t2 = utils::iterator2pointer(first2);
+    auto v = utils::iterator2pointer(values1);
+    auto v2 = utils::iterator2pointer(values2);
+    auto outp = utils::iterator2pointer(out);
+    auto out_valuesp = utils::iterator2pointer(out_values);
+
+    _partitioned_merge_by_key(t, v, p1, r1, t2, v2, p2, r2, outp, out_valuesp, p3, cmp);
 }
 
+template<typename T, typename Invoker, typename BlockMerger, typename BlockPartition, typename Stats>
+template<typename InputIterator, typename OutputIterator, typename Comparator>
+async::handle merger<T, Invoker, BlockMerger, BlockPartition, Stats>::merge_async(InputIterator first1, InputIterator last1,
+                                                                           InputIterator first2, InputIterator last2,
+                                                                           OutputIterator out, Comparator cmp)
+{
+    return async::internal::start([=](size_t) {
+        merge(first1, last1, first2, last2, out, cmp);
+        return false;
+    }, async::internal::queue_of(Invoker()));
 }
 
+namespace internal {
 
-template<typename T>
-struct is_int32 {
-    static constexpr bool value = std::is_same<T, int>::value ||
-                                  std::is_same<T, unsigned int>::value;
-};
+namespace kernel {
+
+// Key orders of the vector kernels, see merge.cpp
+struct signed_order {};
+struct unsigned_order {};
+struct sign_flip_order {};
 
 template<typename T>
-struct is_default_merger_type {
-    static constexpr bool value = !is_int32<T>::value;
+struct key_order {
+    using type = typename std::conditional<std::is_signed<T>::value, signed_order, unsigned_order>::type;
 };
 
-template<typename Iterator, typename Comparator>
-struct is_simd_enabled_comparator {
-    static constexpr bool value = std::is_same<typename std::less<typename std::iterator_traits<Iterator>::value_type>, Comparator>::value;
+template<typename T, size_t Size>
+struct is_int_key {
+    static constexpr bool value = std::is_integral<T>::value && !std::is_same<T, bool>::value && sizeof(T) == Size;
 };
 
-//TODO works incorrectly
-inline int
-sequential_simd_merge(const int *first1, const int *last1, const int *first2, const int *last2, int *res) {
-    size_t a_size = std::distance(first1, last1);
-    size_t b_size = std::distance(first2, last2);
+// Streaming kernel of every tier for key type T, void when the tier has none
+template<typename T, typename Enable = void>
+struct sse4_merge_kernel { using type = void; };
 
-    using utils::print_array;
+template<typename T, typename Enable = void>
+struct avx2_merge_kernel { using type = void; };
 
-    std::cout<<std::endl;
-    print_array(first1, last1, "a");
-    print_array(first2, last2, "b");
+template<typename T, typename Enable = void>
+struct avx512_merge_kernel { using type = void; };
 
-    if(a_size > b_size)
-    {
-        std::swap(first1, first2);
-        std::swap(last1, last2);
-    }
+template<typename K, typename V, typename Enable = void>
+struct avx2_merge_by_key_kernel { using type = void; };
 
-    int* const bres = res;
+#ifdef _USE_AVX2_
+template<typename Order>
+struct avx2_32bit_ops;
 
-    //TODO found a bug. need to find a place in 'b' to put sequence in 'a'. probably recursion with binary search will help
+template<typename Order>
+struct avx2_64bit_ops;
 
-    while(std::distance(first1, last1) >= 8) {
-        //internal::kernel::merge_256i(pa, pb, pres);
-        //internal::kernel::merge_8x8_128i(pa, pb, pres);
-        internal::kernel::merge_8x8_debug(first1, first2, res);
+template<typename Order>
+SAL_TARGET_AVX2 inline void merge_avx2_8x8_32bit(__m256i &vA, __m256i &vB,
+                                                 __m256i &vMin, __m256i &vMax);
 
-        res += 16;
+SAL_TARGET_AVX2 inline void merge_256i(const int *a, const int *b, int *res);
+#endif
+#ifdef _USE_SSE4_
+template<typename Order>
+struct sse4_32bit_ops;
 
-        first1 += 8;
-        first2 += 8;
+SAL_TARGET_SSE4 inline void merge_8x8_128i(const int *a, const int *b, int *res);
+#endif
+#ifdef _USE_AVX512_
+template<typename Order>
+struct avx512_32bit_ops;
+#endif
 
-        print_array(first1, last1, "a");
-        print_array(first2, last2, "b");
-        print_array(bres, a_size+b_size, "res");
+}
 
-    }
 
+template<typename T>
+struct is_simd_key {
+    static constexpr bool value = kernel::is_int_key<T, 4>::value || kernel::is_int_key<T, 8>::value ||
+                                  std::is_same<T, float>::value || std::is_same<T, double>::value;
+};
 
-    if (first1 != last1 || first2 != last2) {
-        std::merge(first1, last1, first2, last2, res);
-    }
+// Payloads move through the vector kernels as raw lanes of the key width
+template<typename K, typename V>
+struct is_simd_key_value {
+    static constexpr bool value = (kernel::is_int_key<K, 4>::value || kernel::is_int_key<K, 8>::value) &&
+                                  sizeof(V) == sizeof(K) && std::is_trivially_copyable<V>::value;
+};
 
-    print_array(bres, a_size+b_size, "res");
+template<typename T>
+struct is_default_merger_type {
+    static constexpr bool value = !is_simd_key<T>::value;
+};
 
-    return 0;
-}
+template<typename Iterator, typename Comparator>
+struct is_simd_enabled_comparator {
+    static constexpr bool value = std::is_same<typename std::less<typename std::iterator_traits<Iterator>::value_type>, Comparator>::value;
+};
+
+/**
+ * Streaming merge of two sorted sequences of 32/64-bit integer, float or double keys of arbitrary
+ * length and alignment. Chunks of 8 (16 for 32-bit keys with AVX-512) are fed through the bitonic
+ * kernel while the upper half of each kernel output is carried in a register to the next step;
+ * the next chunk is taken from the input with the smaller head. Types or tiers without a kernel
+ * fall back to std::merge. The output must not overlap the inputs.
+ */
+template<typename T>
+inline void
+sequential_simd_merge(const T *first1, const T *last1, const T *first2, const T *last2, T *res);
+
+// Key/value variant of sequential_simd_merge over parallel key and payload arrays
+template<typename K, typename V>
+inline void
+sequential_simd_merge_by_key(const K *first1, const K *last1, const V *values1,
+                             const K *first2, const K *last2, const V *values2, K *res, V *res_values);
 
 }
 
-struct simd_int_merger {
+struct simd_merger {
     template<typename InputIterator, typename OutputIterator, typename Comparator>
     void operator()(InputIterator first1, InputIterator last1, InputIterator first2, InputIterator last2,
                     OutputIterator out, Comparator) {
         static_assert(internal::is_simd_enabled_comparator<InputIterator, Comparator>::value,
-                      "simd_int_merger doesn't support custom comparators");
+                      "simd_merger doesn't support custom comparators");
 
         internal::sequential_simd_merge(first1, last1, first2, last2, out);
     }
+
+    template<typename InputIterator, typename ValueInputIterator, typename OutputIterator, typename ValueOutputIterator,
+             typename Comparator>
+    void operator()(InputIterator first1, InputIterator last1, ValueInputIterator values1,
+                    InputIterator first2, InputIterator last2, ValueInputIterator values2,
+                    OutputIterator out, ValueOutputIterator out_values, Comparator) {
+        static_assert(internal::is_simd_enabled_comparator<InputIterator, Comparator>::value,
+                      "simd_merger doesn't support custom comparators");
+
+        internal::sequential_simd_merge_by_key(first1, last1, values1, first2, last2, values2, out, out_values);
+    }
 };
 
+using simd_int_merger = simd_merger;
+
 
 struct auto_merger {
     template<typename InputIterator, typename OutputIterator, typename Comparator>
     typename std::enable_if<
-            internal::is_int32<typename std::iterator_traits<InputIterator>::value_type>::value
+            internal::is_simd_key<typename std::iterator_traits<InputIterator>::value_type>::value
     && internal::is_simd_enabled_comparator<InputIterator, Comparator>::value
     >::type operator()(InputIterator first1, InputIterator last1, InputIterator first2, InputIterator last2,
                OutputIterator out, Comparator cmp) {
-        simd_int_merger()(first1, last1, first2, last2, out, cmp);
+        simd_merger()(first1, last1, first2, last2, out, cmp);
     }
 
 
@@ -280,21 +558,306 @@ struct auto_merger {
             !internal::is_simd_enabled_comparator<InputIterator, Comparator>::value
     >::type operator()(InputIterator first1, InputIterator last1, InputIterator first2, InputIterator last2,
                OutputIterator out, Comparator cmp) {
-        std::merge(first1, last1, first2, last2, out, cmp);
+        std::merge(first1, last1, first2, last2, out, internal::scalar_order(cmp));
+    }
+
+
+    template<typename InputIterator, typename ValueInputIterator, typename OutputIterator, typename ValueOutputIterator,
+             typename Comparator>
+    typename std::enable_if<
+            internal::is_simd_key_value<typename std::iterator_traits<InputIterator>::value_type,
+                                        typename std::iterator_traits<ValueInputIterator>::value_type>::value
+    && internal::is_simd_enabled_comparator<InputIterator, Comparator>::value
+    >::type operator()(InputIterator first1, InputIterator last1, ValueInputIterator values1,
+                       InputIterator first2, InputIterator last2, ValueInputIterator values2,
+                       OutputIterator out, ValueOutputIterator out_values, Comparator cmp) {
+        simd_merger()(first1, last1, values1, first2, last2, values2, out, out_values, cmp);
+    }
+
+
+    template<typename InputIterator, typename ValueInputIterator, typename OutputIterator, typename ValueOutputIterator,
+             typename Comparator>
+    typename std::enable_if<
+            !internal::is_simd_key_value<typename std::iterator_traits<InputIterator>::value_type,
+                                         typename std::iterator_traits<ValueInputIterator>::value_type>::value ||
+            !internal::is_simd_enabled_comparator<InputIterator, Comparator>::value
+    >::type operator()(InputIterator first1, InputIterator last1, ValueInputIterator values1,
+                       InputIterator first2, InputIterator last2, ValueInputIterator values2,
+                       OutputIterator out, ValueOutputIterator out_values, Comparator cmp) {
+        internal::merge_by_key(first1, last1, values1, first2, last2, values2, out, out_values, cmp);
     }
 
 };
 
 
-template<typename Merger, typename Partitioner>
+template<typename Merger, typename Partitioner, typename Stats = stats::no_stats>
 struct merger_settings
 {
     using merger_type = Merger;
     using partitioner_type = Partitioner;
+    using stats_type = Stats;
 };
 
 using default_merger_settings = merger_settings<auto_merger, auto_block_partition>;
 
+/**
+ * Runtime counterparts of auto_block_partition and merge_path_partition. The merge block size and
+ * the parallel cutoff are read from the values tuned for T and Merger on this host, which come from
+ * the cache sizes or a calibration (see tuning.hpp and autotune.hpp).
+ */
+template<typename T, typename Merger = auto_merger>
+struct tuned_block_partition
+{
+    size_t operator()(size_t arr_size, size_t threads)
+    {
+        const size_t block = tuning::values<T, Merger>().merge_block_size;
+        return std::max(block, arr_size / (4 * threads));
+    }
+
+    size_t operator()(size_t arr_size)
+    {
+        return (*this)(arr_size, utils::concurrency(parallel_invoker()));
+    }
+};
+
+template<typename T, typename Merger = auto_merger>
+struct tuned_merge_path_partition
+{
+    size_t operator()(size_t arr_size, size_t threads)
+    {
+        const size_t parts = 4 * threads;
+        return std::max((size_t)1, std::min(parts, arr_size / tuning::values<T, Merger>().parallel_cutoff));
+    }
+
+    size_t operator()(size_t arr_size)
+    {
+        return (*this)(arr_size, utils::concurrency(parallel_invoker()));
+    }
+};
+
+template<typename T, typename Merger>
+struct is_merge_path_partition<tuned_merge_path_partition<T, Merger>> : std::true_type {};
+
+template<typename T, typename Merger = auto_merger>
+using tuned_merger_settings = merger_settings<Merger, tuned_block_partition<T, Merger>>;
+
+namespace internal {
+
+/**
+ * Tournament tree of losers over k sorted sources. Every inner node keeps the key and source of the
+ * loser of the match played there, so replaying the path of the winner's source compares against
+ * cached keys only. Exhausted sources are sentinels that lose every match. Equal keys are won by the
+ * lower source index, which keeps the merge stable.
+ */
+template<typename T, typename Comparator>
+class loser_tree {
+public:
+    loser_tree(size_t k, Comparator cmp) : leaves_(1), cmp_(cmp)
+    {
+        while (leaves_ < k)
+            leaves_ *= 2;
+
+        keys_.resize(leaves_);
+        sources_.resize(leaves_);
+        start_keys_.resize(leaves_);
+        start_sources_.resize(leaves_);
+        for (size_t s = 0; s < leaves_; s++)
+            start_sources_[s] = s | sentinel_bit;
+    }
+
+    // First key of source s, must be set for every non-empty source before build()
+    void set_start(size_t s, const T &key)
+    {
+        start_keys_[s] = key;
+        start_sources_[s] = s;
+    }
+
+    void build()
+    {
+        sources_[0] = play(1, keys_[0]);
+    }
+
+    bool empty() const { return (sources_[0] & sentinel_bit) != 0; }
+
+    size_t min_source() const { return sources_[0]; }
+
+    const T &min_key() const { return keys_[0]; }
+
+    // Replaces the winner by the next key of its source, or by a sentinel when key is null
+    void replace_min(const T *key)
+    {
+        T cur_key = key ? *key : keys_[0];
+        size_t cur_source = key ? sources_[0] : sources_[0] | sentinel_bit;
+
+        //the path of a random source is unpredictable, so every match is decided without branches
+        for (size_t x = (leaves_ + (cur_source & ~sentinel_bit)) / 2; x > 0; x /= 2) {
+            //indexing by the outcome keeps the compiler from turning the selects back into branches
+            const T keys[2] = { cur_key, keys_[x] };
+            const size_t sources[2] = { cur_source, sources_[x] };
+
+            const size_t swap = beats(keys[1], sources[1], keys[0], sources[0]);
+            keys_[x] = keys[1 - swap];
+            sources_[x] = sources[1 - swap];
+            cur_key = keys[swap];
+            cur_source = sources[swap];
+        }
+
+        keys_[0] = cur_key;
+        sources_[0] = cur_source;
+    }
+
+private:
+    static constexpr size_t sentinel_bit = ~(~size_t(0) >> 1);
+
+    bool beats(const T &a_key, size_t a_source, const T &b_key, size_t b_source) const
+    {
+        const bool less = cmp_(a_key, b_key);
+        const bool tie = !cmp_(b_key, a_key) & (a_source < b_source);
+
+        return ((a_source & sentinel_bit) == 0) & (((b_source & sentinel_bit) != 0) | less | tie);
+    }
+
+    // Source of the winner of the subtree at x, its key is stored to key
+    size_t play(size_t x, T &key)
+    {
+        if (x >= leaves_) {
+            key = start_keys_[x - leaves_];
+            return start_sources_[x - leaves_];
+        }
+
+        T a_key, b_key;
+        size_t a = play(2 * x, a_key);
+        size_t b = play(2 * x + 1, b_key);
+
+        if (beats(a_key, a, b_key, b)) {
+            keys_[x] = b_key;
+            sources_[x] = b;
+            key = a_key;
+            return a;
+        }
+
+        keys_[x] = a_key;
+        sources_[x] = a;
+        key = b_key;
+        return b;
+    }
+
+    size_t leaves_;
+    std::vector<T> keys_;
+    std::vector<size_t> sources_;
+    std::vector<T> start_keys_;
+    std::vector<size_t> start_sources_;
+    Comparator cmp_;
+};
+
+template<typename T>
+using sorted_run = std::pair<const T *, const T *>;
+
+// Sequential stable merge of the runs into out, returns the end of the output
+template<typename T, typename Comparator>
+T *kway_merge(const sorted_run<T> *runs, size_t k, T *out, Comparator cmp);
+
+/**
+ * Multi-sequence selection: split positions of the runs such that the first `rank` keys of the
+ * stable merge are exactly the keys before the splits. Narrows a window per run around the split,
+ * pivoting on the middle of the widest window and counting the keys ordered before the pivot.
+ */
+template<typename T, typename Comparator>
+void multiway_select(const sorted_run<T> *runs, size_t k, size_t rank, size_t *splits, Comparator cmp);
+
+// Slices of a k-way merge of n keys on invoker: the count of a merge-path partition, n over the block of a block partition
+template<typename Partition, typename Invoker>
+size_t kway_parts(size_t n, const Invoker &invoker)
+{
+    const size_t value = merge::partition<Partition>(n, invoker);
+    if (is_merge_path_partition<Partition>::value)
+        return std::max((size_t)1, value);
+
+    return std::max((size_t)1, n / std::max((size_t)1, value));
+}
+
+}
+
+/**
+ * Single-pass merge of any number of sorted runs with a loser tree. The output is cut into slices
+ * by multi-sequence selection, as many as a merge-path Partition returns or of the size a block
+ * Partition returns, and the slices are merged independently as tasks of Invoker; a serial
+ * Invoker merges in one slice. Stable: equal keys keep the order of their runs.
+ */
+template<typename T, typename Partition = merge_path_partition<>, typename Invoker = parallel_invoker>
+class kway_merger {
+public:
+    kway_merger() = delete;
+
+    template<typename InputIterator, typename OutputIterator, typename Comparator = std::less<T>>
+    static void merge(const std::vector<std::pair<InputIterator, InputIterator>> &runs, OutputIterator out,
+                      Comparator cmp = Comparator());
+
+    template<typename Comparator = std::less<T>>
+    static void merge(const internal::sorted_run<T> *runs, size_t k, T *out, Comparator cmp = Comparator());
+};
+
+template<typename T, typename Partition, typename Invoker>
+template<typename InputIterator, typename OutputIterator, typename Comparator>
+void kway_merger<T, Partition, Invoker>::merge(const std::vector<std::pair<InputIterator, InputIterator>> &runs,
+                                      OutputIterator out, Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<InputIterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<InputIterator>::value && is_random_access_iterator<OutputIterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    std::vector<internal::sorted_run<T>> ptr_runs;
+    ptr_runs.reserve(runs.size());
+    for (auto &run : runs) {
+        if (run.first != run.second) {
+            const T *first = utils::iterator2pointer(run.first);
+            ptr_runs.emplace_back(first, first + std::distance(run.first, run.second));
+        }
+    }
+
+    if (ptr_runs.empty())
+        return;
+
+    merge(ptr_runs.data(), ptr_runs.size(), utils::iterator2pointer(out), cmp);
+}
+
+template<typename T, typename Partition, typename Invoker>
+template<typename Comparator>
+void kway_merger<T, Partition, Invoker>::merge(const internal::sorted_run<T> *runs, size_t k, T *out, Comparator cmp)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < k; ++i)
+        n += runs[i].second - runs[i].first;
+
+    if (n == 0)
+        return;
+
+    auto order = internal::scalar_order(cmp);
+    const size_t parts = utils::is_serial(Invoker()) ? 1 : internal::kway_parts<Partition>(n, Invoker());
+    if (parts <= 1) {
+        internal::kway_merge(runs, k, out, order);
+        return;
+    }
+
+    //splits[p * k + i] is the start of slice p in run i
+    std::vector<size_t> splits((parts + 1) * k);
+    for (size_t i = 0; i < k; ++i)
+        splits[parts * k + i] = runs[i].second - runs[i].first;
+
+    utils::parallel_for(Invoker(), 1, parts, [&](size_t p) {
+        internal::multiway_select(runs, k, n * p / parts, &splits[p * k], order);
+    });
+
+    utils::parallel_for(Invoker(), 0, parts, [&](size_t p) {
+        std::vector<internal::sorted_run<T>> slice(k);
+        for (size_t i = 0; i < k; ++i)
+            slice[i] = internal::sorted_run<T>(runs[i].first + splits[p * k + i], runs[i].first + splits[(p + 1) * k + i]);
+
+        internal::kway_merge(slice.data(), k, out + n * p / parts, order);
+    });
+}
+
 }}
 
 #include "merge.cpp"
@@ -0,0 +1,163 @@
+//
+// Page placement of large buffers on NUMA machines.
+//
+
+#ifndef SAL_NUMA_HPP
+#define SAL_NUMA_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace sal {
+
+namespace utils {
+#ifdef SAL_NO_TBB
+struct pool_invoker;
+using parallel_invoker = pool_invoker;
+#else
+struct parallel_invoker;
+#endif
+}
+
+namespace numa {
+
+constexpr std::size_t page_size = 4096;
+
+// Online NUMA nodes, a single node 0 where the topology is unknown
+inline const std::vector<int>& online_nodes()
+{
+    static const std::vector<int> nodes = [] {
+        std::vector<int> result;
+#ifdef __linux__
+        //ranges such as "0-1,4"
+        std::ifstream file("/sys/devices/system/node/online");
+        std::string list;
+        if (file >> list) {
+            size_t pos = 0;
+            while (pos < list.size()) {
+                size_t end = list.find(',', pos);
+                if (end == std::string::npos)
+                    end = list.size();
+
+                const std::string range = list.substr(pos, end - pos);
+                const size_t dash = range.find('-');
+                const int first = std::stoi(range.substr(0, dash));
+                const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (int node = first; node <= last; ++node)
+                    result.push_back(node);
+
+                pos = end + 1;
+            }
+        }
+#endif
+        if (result.empty())
+            result.push_back(0);
+
+        return result;
+    }();
+
+    return nodes;
+}
+
+inline std::size_t node_count()
+{
+    return online_nodes().size();
+}
+
+namespace internal {
+
+// Pages one task touches, where a small buffer lands does not matter
+constexpr std::size_t touch_grain = 256;
+
+template<typename Invoker>
+void touch(char* first, std::size_t p, std::size_t q, Invoker invoker)
+{
+    if (q - p <= touch_grain) {
+        for (; p < q; ++p)
+            first[p * page_size] = 0;
+
+        return;
+    }
+
+    const std::size_t mid = p + (q - p) / 2;
+    invoker(
+            [&]{touch(first, p, mid, invoker);},
+            [&]{touch(first, mid, q, invoker);}
+    );
+}
+
+}
+
+/**
+ * Touches every page of a fresh allocation from the threads of invoker, halving the pages as
+ * tasks the way the sorters halve their input, so the pages land on the node of the thread that
+ * works on them later. Any invoker of the sorters works, none of them needs TBB here.
+ */
+template<typename Invoker>
+void first_touch(void* data, std::size_t bytes, Invoker invoker)
+{
+    const std::size_t pages = (bytes + page_size - 1) / page_size;
+    internal::touch(static_cast<char*>(data), 0, pages, invoker);
+}
+
+/**
+ * Interleaves the pages of a page aligned, not yet touched allocation round-robin across the online
+ * nodes. Placement is a hint: single node machines and kernels without mbind are left unchanged.
+ */
+inline void interleave(void* data, std::size_t bytes)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    const std::vector<int>& nodes = online_nodes();
+    if (nodes.size() < 2)
+        return;
+
+    const std::size_t word_bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(nodes.back() / word_bits + 1, 0);
+    for (int node : nodes)
+        mask[node / word_bits] |= 1UL << (node % word_bits);
+
+    const int mpol_interleave = 3;
+    const std::size_t length = (bytes + page_size - 1) / page_size * page_size;
+    syscall(SYS_mbind, data, length, mpol_interleave, mask.data(), mask.size() * word_bits + 1, 0);
+#else
+    (void) data;
+    (void) bytes;
+#endif
+}
+
+// Pages are placed by whichever thread touches them first, usually the allocating one
+struct default_placement {
+    static constexpr std::size_t alignment = 1;
+
+    static void place(void*, std::size_t) { }
+};
+
+// Pages are spread over the threads of Invoker that will later work on them, see first_touch()
+template<typename Invoker = utils::parallel_invoker>
+struct first_touch_placement {
+    static constexpr std::size_t alignment = page_size;
+
+    static void place(void* data, std::size_t bytes) { first_touch(data, bytes, Invoker()); }
+};
+
+// Pages are interleaved across nodes, for buffers that every thread reads, see interleave()
+template<typename Invoker = utils::parallel_invoker>
+struct interleave_placement {
+    static constexpr std::size_t alignment = page_size;
+
+    static void place(void* data, std::size_t bytes)
+    {
+        interleave(data, bytes);
+        first_touch(data, bytes, Invoker());
+    }
+};
+
+}}
+
+#endif //SAL_NUMA_HPP
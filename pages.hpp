@@ -0,0 +1,186 @@
+//
+// Page size policies of aligned_allocator: regular pages or huge pages for large buffers.
+//
+
+#ifndef SAL_PAGES_HPP
+#define SAL_PAGES_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <immintrin.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace sal { namespace pages {
+
+constexpr std::size_t huge_page_size = 2 << 20;
+
+enum class page_kind {
+    small,
+    transparent,
+    hugetlb
+};
+
+// Number of allocations above the huge page threshold that got each kind of page since the start of the process
+struct allocation_stats {
+    std::size_t small;
+    std::size_t transparent;
+    std::size_t hugetlb;
+};
+
+namespace internal {
+
+inline std::atomic<std::size_t>* counters()
+{
+    static std::atomic<std::size_t> counts[3] = {};
+    return counts;
+}
+
+inline void record(page_kind kind)
+{
+    counters()[static_cast<int>(kind)].fetch_add(1, std::memory_order_relaxed);
+}
+
+inline std::size_t huge_length(std::size_t bytes)
+{
+    return (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+}
+
+#ifdef __linux__
+// Anonymous mapping of length bytes aligned to a huge page, with transparent huge pages requested
+inline void* map_transparent(std::size_t length)
+{
+    void* raw = mmap(nullptr, length + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        throw std::bad_alloc();
+
+    //trim the mapping to the aligned range
+    char* first = static_cast<char*>(raw);
+    char* data = reinterpret_cast<char*>(huge_length(reinterpret_cast<std::uintptr_t>(first)));
+    if (data != first)
+        munmap(first, data - first);
+    if (data + length != first + length + huge_page_size)
+        munmap(data + length, first + huge_page_size - data);
+
+#ifdef MADV_HUGEPAGE
+    record(madvise(data, length, MADV_HUGEPAGE) == 0 ? page_kind::transparent : page_kind::small);
+#else
+    record(page_kind::small);
+#endif
+    return data;
+}
+#endif
+
+}
+
+inline allocation_stats statistics()
+{
+    std::atomic<std::size_t>* counts = internal::counters();
+    return { counts[0].load(), counts[1].load(), counts[2].load() };
+}
+
+/**
+ * Bytes of [data, data + bytes) currently backed by huge pages, from /proc/self/smaps. Transparent
+ * huge pages are only a request, this tells whether the kernel granted it. Zero where unsupported.
+ */
+inline std::size_t huge_page_bytes(const void* data, std::size_t bytes)
+{
+    std::size_t total = 0;
+#ifdef __linux__
+    std::FILE* smaps = std::fopen("/proc/self/smaps", "r");
+    if (!smaps)
+        return 0;
+
+    const std::uintptr_t first = reinterpret_cast<std::uintptr_t>(data);
+    const std::uintptr_t last = first + bytes;
+    bool inside = false;
+    char line[512];
+
+    while (std::fgets(line, sizeof(line), smaps)) {
+        unsigned long begin, end, kb;
+        //mapping headers start with the address range, their fields follow
+        if (std::sscanf(line, "%lx-%lx ", &begin, &end) == 2) {
+            inside = begin < last && end > first;
+        } else if (inside && (std::sscanf(line, "AnonHugePages: %lu kB", &kb) == 1 ||
+                              std::sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1)) {
+            total += kb * 1024;
+        }
+    }
+
+    std::fclose(smaps);
+#else
+    (void) data;
+    (void) bytes;
+#endif
+    return total < bytes ? total : bytes;
+}
+
+// Regular pages from the C runtime
+struct small_pages {
+    static void* allocate(std::size_t bytes, std::size_t alignment) { return _mm_malloc(bytes, alignment); }
+
+    static void deallocate(void* data, std::size_t) { _mm_free(data); }
+};
+
+/**
+ * Allocations of at least Threshold bytes are mapped at huge page alignment, which covers any
+ * requested alignment up to 2 MiB, with transparent huge pages requested through madvise.
+ * Smaller ones use regular pages.
+ */
+template<std::size_t Threshold = 2 * huge_page_size>
+struct transparent_huge_pages {
+    static void* allocate(std::size_t bytes, std::size_t alignment)
+    {
+#ifdef __linux__
+        if (bytes >= Threshold)
+            return internal::map_transparent(internal::huge_length(bytes));
+#endif
+        return small_pages::allocate(bytes, alignment);
+    }
+
+    static void deallocate(void* data, std::size_t bytes)
+    {
+#ifdef __linux__
+        if (bytes >= Threshold) {
+            munmap(data, internal::huge_length(bytes));
+            return;
+        }
+#endif
+        small_pages::deallocate(data, bytes);
+    }
+};
+
+/**
+ * Like transparent_huge_pages, but large allocations are first tried from the reserved hugetlbfs
+ * pool with MAP_HUGETLB, falling back to transparent huge pages when the pool cannot serve them.
+ */
+template<std::size_t Threshold = 2 * huge_page_size>
+struct explicit_huge_pages {
+    static void* allocate(std::size_t bytes, std::size_t alignment)
+    {
+#if defined(__linux__) && defined(MAP_HUGETLB)
+        if (bytes >= Threshold) {
+            const std::size_t length = internal::huge_length(bytes);
+            void* data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (data != MAP_FAILED) {
+                internal::record(page_kind::hugetlb);
+                return data;
+            }
+        }
+#endif
+        return transparent_huge_pages<Threshold>::allocate(bytes, alignment);
+    }
+
+    static void deallocate(void* data, std::size_t bytes)
+    {
+        transparent_huge_pages<Threshold>::deallocate(data, bytes);
+    }
+};
+
+}}
+
+#endif //SAL_PAGES_HPP
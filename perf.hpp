@@ -0,0 +1,409 @@
+//
+// Hardware performance counters per sort phase and thread, compiled in with SAL_PERF_COUNTERS.
+//
+
+#ifndef SAL_PERF_HPP
+#define SAL_PERF_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#ifdef SAL_PERF_COUNTERS
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+/**
+ * Phase markers of the sorters and mergers. Without SAL_PERF_COUNTERS they expand to nothing, so
+ * the instrumented code is exactly the uninstrumented one. SAL_PERF_SCOPE(name, phase) counts
+ * the enclosing block as phase; SAL_PERF_CURRENT(name) names the phase of the calling thread so
+ * tasks it spawns can resume it with SAL_PERF_SCOPE on whatever thread runs them.
+ */
+#ifdef SAL_PERF_COUNTERS
+#define SAL_PERF_SCOPE(name, phase) ::sal::perf::scope name(phase)
+#define SAL_PERF_CURRENT(name) const ::sal::perf::phase name = ::sal::perf::current_phase()
+#else
+#define SAL_PERF_SCOPE(name, phase) ((void) 0)
+#define SAL_PERF_CURRENT(name) ((void) 0)
+#endif
+
+namespace sal { namespace perf {
+
+enum class event {
+    cycles,
+    instructions,
+    llc_misses,
+    branch_misses,
+    dtlb_misses
+};
+
+constexpr std::size_t event_count = 5;
+
+inline const char* event_name(event e)
+{
+    static const char* const names[event_count] = { "cycles", "instructions", "llc_misses", "branch_misses", "dtlb_misses" };
+    return names[static_cast<int>(e)];
+}
+
+// Counts of one phase, exclusive of the phases nested in it
+struct counters {
+    std::array<std::uint64_t, event_count> values;
+    std::uint64_t nanoseconds;
+    std::uint64_t calls;
+
+    counters() : values(), nanoseconds(0), calls(0) { }
+
+    std::uint64_t operator[](event e) const { return values[static_cast<int>(e)]; }
+
+    counters& operator+=(const counters& other)
+    {
+        for (std::size_t i = 0; i < event_count; ++i)
+            values[i] += other.values[i];
+        nanoseconds += other.nanoseconds;
+        calls += other.calls;
+        return *this;
+    }
+};
+
+enum class phase_kind {
+    none,
+    leaf_sort,
+    merge,
+    copy
+};
+
+// Merge levels count from the leaves, see merge_level(); multiway_merge_sort reports its rounds as levels
+struct phase {
+    phase_kind kind;
+    unsigned level;
+
+    static phase none() { return { phase_kind::none, 0 }; }
+    static phase leaf_sort() { return { phase_kind::leaf_sort, 0 }; }
+    static phase merge(unsigned level) { return { phase_kind::merge, level }; }
+    static phase copy() { return { phase_kind::copy, 0 }; }
+
+    bool operator==(const phase& other) const { return kind == other.kind && level == other.level; }
+};
+
+// Level of a merge of n keys by its size: level k produces at least leaf * 2^k and less than twice that
+inline unsigned merge_level(std::size_t n, std::size_t leaf)
+{
+    unsigned level = 0;
+    while (leaf << (level + 1) <= n)
+        ++level;
+    return level;
+}
+
+struct phase_report {
+    counters leaf_sort;
+    std::vector<counters> merge_levels;
+    counters final_copy;
+
+    counters& at(const phase& p)
+    {
+        if (p.kind == phase_kind::leaf_sort)
+            return leaf_sort;
+        if (p.kind == phase_kind::copy)
+            return final_copy;
+        if (merge_levels.size() <= p.level)
+            merge_levels.resize(p.level + 1);
+        return merge_levels[p.level];
+    }
+
+    phase_report& operator+=(const phase_report& other)
+    {
+        leaf_sort += other.leaf_sort;
+        final_copy += other.final_copy;
+        if (merge_levels.size() < other.merge_levels.size())
+            merge_levels.resize(other.merge_levels.size());
+        for (std::size_t i = 0; i < other.merge_levels.size(); ++i)
+            merge_levels[i] += other.merge_levels[i];
+        return *this;
+    }
+};
+
+/**
+ * Result of profile(). instrumented is false when the library was built without SAL_PERF_COUNTERS;
+ * an event is unavailable when perf_event_open refused it (no PMU access, perf_event_paranoid),
+ * its counts are zero then while the times are still measured.
+ */
+struct sort_report {
+    bool instrumented;
+    std::array<bool, event_count> available;
+    phase_report total;
+    std::vector<phase_report> threads;      // one per thread that ran a phase, in order of its first phase
+
+    sort_report() : instrumented(false), available() { }
+};
+
+#ifdef SAL_PERF_COUNTERS
+namespace internal {
+
+// Counter group of the calling thread, user space only, opened on first use and kept for the thread's lifetime
+class thread_counters {
+public:
+    thread_counters() : leader_(-1), members_(0)
+    {
+        for (std::size_t i = 0; i < event_count; ++i) {
+            fds_[i] = -1;
+            slot_[i] = -1;
+        }
+
+#if defined(__linux__) && defined(SYS_perf_event_open)
+        const std::uint32_t types[event_count] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                                   PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+        const std::uint64_t configs[event_count] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+        };
+
+        for (std::size_t i = 0; i < event_count; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[i];
+            attr.config = configs[i];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            //events the PMU lacks are left out of the group instead of failing it
+            fds_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+            if (fds_[i] < 0)
+                continue;
+
+            if (leader_ < 0)
+                leader_ = fds_[i];
+            slot_[i] = members_++;
+        }
+#endif
+    }
+
+    ~thread_counters()
+    {
+#if defined(__linux__)
+        for (int fd : fds_) {
+            if (fd >= 0)
+                close(fd);
+        }
+#endif
+    }
+
+    thread_counters(const thread_counters&) = delete;
+    thread_counters& operator=(const thread_counters&) = delete;
+
+    bool available(event e) const { return slot_[static_cast<int>(e)] >= 0; }
+
+    // Running totals of the events, scaled up when the kernel multiplexed the group
+    void read(counters& out) const
+    {
+        out.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+
+#if defined(__linux__)
+        std::uint64_t data[3 + event_count];
+        if (leader_ < 0 || ::read(leader_, data, sizeof(data)) < static_cast<ssize_t>((3 + members_) * sizeof(std::uint64_t)))
+            return;
+
+        const double scale = data[2] ? static_cast<double>(data[1]) / data[2] : 0;
+        for (std::size_t i = 0; i < event_count; ++i) {
+            if (slot_[i] >= 0)
+                out.values[i] = static_cast<std::uint64_t>(data[3 + slot_[i]] * scale);
+        }
+#endif
+    }
+
+private:
+    int leader_;
+    int members_;
+    int fds_[event_count];
+    int slot_[event_count];
+};
+
+inline thread_counters& this_thread_counters()
+{
+    static thread_local thread_counters c;
+    return c;
+}
+
+struct session {
+    unsigned generation;
+    std::mutex mutex;
+    std::deque<phase_report> threads;
+};
+
+inline std::atomic<session*>& active_session()
+{
+    static std::atomic<session*> s(nullptr);
+    return s;
+}
+
+// Serializes profile() calls and numbers their sessions, thread states of older sessions are stale
+inline std::mutex& profile_mutex()
+{
+    static std::mutex m;
+    return m;
+}
+
+inline unsigned next_generation()
+{
+    static unsigned generation = 0;
+    return ++generation;
+}
+
+// Phases open on the calling thread; the innermost one is charged
+struct thread_state {
+    unsigned generation = 0;
+    phase_report* report = nullptr;
+    std::vector<phase> stack;
+    counters last;
+};
+
+inline thread_state& this_thread_state()
+{
+    static thread_local thread_state state;
+    return state;
+}
+
+// Charges the counts since the last reading of the thread to the innermost open phase
+inline void charge(thread_state& state, const counters& now, bool closing)
+{
+    counters& target = state.report->at(state.stack.back());
+    for (std::size_t i = 0; i < event_count; ++i)
+        target.values[i] += now.values[i] - state.last.values[i];
+    target.nanoseconds += now.nanoseconds - state.last.nanoseconds;
+    target.calls += closing;
+    state.last = now;
+}
+
+}
+
+inline phase current_phase()
+{
+    internal::thread_state& state = internal::this_thread_state();
+    internal::session* s = internal::active_session().load(std::memory_order_acquire);
+    if (!s || state.generation != s->generation || state.stack.empty())
+        return phase::none();
+
+    return state.stack.back();
+}
+
+/**
+ * Counts its lifetime on this thread as phase p while profile() runs. Opening a phase that is
+ * already the innermost one of the thread is free, so resuming a phase in spawned tasks only
+ * costs when the task was stolen by another thread.
+ */
+class scope {
+public:
+    explicit scope(const phase& p) : active_(false)
+    {
+        internal::session* s = internal::active_session().load(std::memory_order_acquire);
+        if (!s || p.kind == phase_kind::none)
+            return;
+
+        internal::thread_state& state = internal::this_thread_state();
+        if (state.generation != s->generation) {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            s->threads.emplace_back();
+            state.generation = s->generation;
+            state.report = &s->threads.back();
+            state.stack.clear();
+        }
+
+        if (!state.stack.empty() && state.stack.back() == p)
+            return;
+
+        counters now;
+        internal::this_thread_counters().read(now);
+        if (state.stack.empty())
+            state.last = now;
+        else
+            internal::charge(state, now, false);
+
+        state.stack.push_back(p);
+        active_ = true;
+    }
+
+    ~scope()
+    {
+        if (!active_)
+            return;
+
+        //a scope of another sort can outlive the profile that saw it open
+        internal::thread_state& state = internal::this_thread_state();
+        internal::session* s = internal::active_session().load(std::memory_order_acquire);
+        if (s && s->generation == state.generation) {
+            counters now;
+            internal::this_thread_counters().read(now);
+            internal::charge(state, now, true);
+            state.stack.pop_back();
+        }
+    }
+
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+
+private:
+    bool active_;
+};
+
+/**
+ * Runs f, typically one sort, and returns the counts of every phase it ran, per thread and in
+ * total. Profiles run one at a time; other sorts running meanwhile on other threads are counted too.
+ */
+template<typename F>
+sort_report profile(F f)
+{
+    std::lock_guard<std::mutex> lock(internal::profile_mutex());
+
+    internal::session s;
+    s.generation = internal::next_generation();
+
+    sort_report report;
+    report.instrumented = true;
+    for (std::size_t i = 0; i < event_count; ++i)
+        report.available[i] = internal::this_thread_counters().available(static_cast<event>(i));
+
+    internal::active_session().store(&s, std::memory_order_release);
+    try {
+        f();
+    } catch (...) {
+        internal::active_session().store(nullptr, std::memory_order_release);
+        throw;
+    }
+    internal::active_session().store(nullptr, std::memory_order_release);
+
+    for (auto& thread : s.threads) {
+        report.total += thread;
+        report.threads.push_back(thread);
+    }
+
+    return report;
+}
+#else
+inline phase current_phase()
+{
+    return phase::none();
+}
+
+// Instrumentation is compiled out: runs f and returns an empty report
+template<typename F>
+sort_report profile(F f)
+{
+    f();
+    return sort_report();
+}
+#endif
+
+}}
+
+#endif //SAL_PERF_HPP
@@ -0,0 +1,633 @@
+//
+// Vectorized and radix sorts used by the block sorters and radix_sorter
+//
+#ifndef SAL_SORT_CPP
+#define SAL_SORT_CPP
+#include "sort.hpp"
+
+namespace sal { namespace sort { namespace internal {
+
+namespace kernel {
+
+using namespace merge::internal::kernel;
+
+/*
+ * Tiles of rows x width keys are loaded into registers and sorted column-wise by a lane-wise bitonic
+ * network, so every lane holds a sorted column. A transpose turns the columns into sorted runs of
+ * `rows` keys, which are merged pairwise in registers with the streaming merge kernel of the type.
+ * The runs of all tiles are then merged bottom-up by the streaming merge. Compare-exchanges call
+ * min(a, b) and max(b, a) so that equal floating point keys stay a permutation of the input.
+ */
+#ifdef _USE_AVX2_
+template<typename Ops, typename Reg, size_t N>
+SAL_TARGET_AVX2 inline void sort_columns_avx2(Reg (&r)[N]) {
+    for (size_t k = 2; k <= N; k <<= 1) {
+        for (size_t j = k >> 1; j > 0; j >>= 1) {
+            for (size_t i = 0; i < N; ++i) {
+                size_t l = i ^ j;
+                if (l <= i || l >= N)
+                    continue;
+
+                Reg lo = Ops::min(r[i], r[l]);
+                Reg hi = Ops::max(r[l], r[i]);
+                r[i] = (i & k) ? hi : lo;
+                r[l] = (i & k) ? lo : hi;
+            }
+        }
+    }
+}
+
+SAL_TARGET_AVX2 inline void transpose_avx2_8x8(__m256i (&r)[8]) {
+    __m256i t[8], u[8];
+
+    for (size_t i = 0; i < 8; i += 2) {
+        t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+    }
+
+    //u[4i+k] holds in its 128-bit lane L the rows 4i..4i+3 of column 4L+k
+    for (size_t i = 0; i < 8; i += 4) {
+        u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+
+    for (size_t k = 0; k < 4; ++k) {
+        r[k] = _mm256_permute2x128_si256(u[k], u[k + 4], 0x20);
+        r[k + 4] = _mm256_permute2x128_si256(u[k], u[k + 4], 0x31);
+    }
+}
+
+SAL_TARGET_AVX2 inline void transpose_avx2_8x8(__m256 (&r)[8]) {
+    __m256i v[8];
+    for (size_t i = 0; i < 8; ++i)
+        v[i] = _mm256_castps_si256(r[i]);
+
+    transpose_avx2_8x8(v);
+
+    for (size_t i = 0; i < 8; ++i)
+        r[i] = _mm256_castsi256_ps(v[i]);
+}
+
+SAL_TARGET_AVX2 inline void transpose_avx2_4x4(__m256i &a, __m256i &b, __m256i &c, __m256i &d) {
+    __m256i t0 = _mm256_unpacklo_epi64(a, b);
+    __m256i t1 = _mm256_unpackhi_epi64(a, b);
+    __m256i t2 = _mm256_unpacklo_epi64(c, d);
+    __m256i t3 = _mm256_unpackhi_epi64(c, d);
+
+    a = _mm256_permute2x128_si256(t0, t2, 0x20);
+    b = _mm256_permute2x128_si256(t1, t3, 0x20);
+    c = _mm256_permute2x128_si256(t0, t2, 0x31);
+    d = _mm256_permute2x128_si256(t1, t3, 0x31);
+}
+
+SAL_TARGET_AVX2 inline void transpose_avx2_4x4(__m256d &a, __m256d &b, __m256d &c, __m256d &d) {
+    __m256i va = _mm256_castpd_si256(a), vb = _mm256_castpd_si256(b);
+    __m256i vc = _mm256_castpd_si256(c), vd = _mm256_castpd_si256(d);
+
+    transpose_avx2_4x4(va, vb, vc, vd);
+
+    a = _mm256_castsi256_pd(va);
+    b = _mm256_castsi256_pd(vb);
+    c = _mm256_castsi256_pd(vc);
+    d = _mm256_castsi256_pd(vd);
+}
+
+// 8x8 tile of 32-bit keys, leaves 4 sorted runs of 16
+template<typename Kernel, typename Ops = typename Kernel::ops>
+struct avx2_8x8_tile
+{
+    using value_type = typename Kernel::value_type;
+    using kernel = Kernel;
+    using reg_type = typename Kernel::reg_type;
+    static constexpr size_t size = 64;
+    static constexpr size_t run = 16;
+
+    SAL_TARGET_AVX2 static void sort(value_type *p)
+    {
+        reg_type r[8];
+        for (size_t i = 0; i < 8; ++i)
+            Kernel::load(p + 8 * i, r[i]);
+
+        sort_columns_avx2<Ops>(r);
+        transpose_avx2_8x8(r);
+
+        for (size_t i = 0; i < 8; i += 2) {
+            reg_type vMin, vMax;
+            Kernel::merge(r[i], r[i + 1], vMin, vMax);
+            Kernel::store(p + 8 * i, vMin);
+            Kernel::store(p + 8 * i + 8, vMax);
+        }
+    }
+};
+
+// 8x4 tile of 64-bit keys, each kernel register holds two rows. Leaves 2 sorted runs of 16.
+template<typename Kernel, typename Ops = typename Kernel::ops>
+struct avx2_8x4_tile
+{
+    using value_type = typename Kernel::value_type;
+    using kernel = Kernel;
+    using reg_type = typename Kernel::reg_type;
+    static constexpr size_t size = 32;
+    static constexpr size_t run = 16;
+
+    SAL_TARGET_AVX2 static void sort(value_type *p)
+    {
+        reg_type k[4];
+        for (size_t i = 0; i < 4; ++i)
+            Kernel::load(p + 8 * i, k[i]);
+
+        decltype(k[0].lo) r[8];
+        for (size_t i = 0; i < 4; ++i) {
+            r[2 * i] = k[i].lo;
+            r[2 * i + 1] = k[i].hi;
+        }
+
+        sort_columns_avx2<Ops>(r);
+        transpose_avx2_4x4(r[0], r[1], r[2], r[3]);
+        transpose_avx2_4x4(r[4], r[5], r[6], r[7]);
+
+        //column c is rows 0..3 in r[c] followed by rows 4..7 in r[c+4]
+        for (size_t c = 0; c < 4; ++c) {
+            k[c].lo = r[c];
+            k[c].hi = r[c + 4];
+        }
+
+        for (size_t i = 0; i < 4; i += 2) {
+            reg_type vMin, vMax;
+            Kernel::merge(k[i], k[i + 1], vMin, vMax);
+            Kernel::store(p + 8 * i, vMin);
+            Kernel::store(p + 8 * i + 8, vMax);
+        }
+    }
+};
+#endif
+
+#ifdef _USE_AVX512_
+// GCC 12 reports the self-initialized _mm512_undefined_* values inside the AVX-512 intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+template<typename Ops, typename Reg, size_t N>
+SAL_TARGET_AVX512 inline void sort_columns_avx512(Reg (&r)[N]) {
+    for (size_t k = 2; k <= N; k <<= 1) {
+        for (size_t j = k >> 1; j > 0; j >>= 1) {
+            for (size_t i = 0; i < N; ++i) {
+                size_t l = i ^ j;
+                if (l <= i || l >= N)
+                    continue;
+
+                Reg lo = Ops::min(r[i], r[l]);
+                Reg hi = Ops::max(r[l], r[i]);
+                r[i] = (i & k) ? hi : lo;
+                r[l] = (i & k) ? lo : hi;
+            }
+        }
+    }
+}
+
+SAL_TARGET_AVX512 inline void transpose_avx512_16x16(__m512i (&r)[16]) {
+    __m512i t[16], u[16];
+
+    for (size_t i = 0; i < 16; i += 2) {
+        t[i] = _mm512_unpacklo_epi32(r[i], r[i + 1]);
+        t[i + 1] = _mm512_unpackhi_epi32(r[i], r[i + 1]);
+    }
+
+    //u[4i+k] holds in its 128-bit lane L the rows 4i..4i+3 of column 4L+k
+    for (size_t i = 0; i < 16; i += 4) {
+        u[i] = _mm512_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm512_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm512_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm512_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+
+    //4x4 transpose of the 128-bit lanes of u[k], u[k+4], u[k+8], u[k+12]
+    for (size_t k = 0; k < 4; ++k) {
+        __m512i v0 = _mm512_shuffle_i32x4(u[k], u[k + 4], 0x88);
+        __m512i v1 = _mm512_shuffle_i32x4(u[k], u[k + 4], 0xDD);
+        __m512i v2 = _mm512_shuffle_i32x4(u[k + 8], u[k + 12], 0x88);
+        __m512i v3 = _mm512_shuffle_i32x4(u[k + 8], u[k + 12], 0xDD);
+
+        r[k] = _mm512_shuffle_i32x4(v0, v2, 0x88);
+        r[k + 4] = _mm512_shuffle_i32x4(v1, v3, 0x88);
+        r[k + 8] = _mm512_shuffle_i32x4(v0, v2, 0xDD);
+        r[k + 12] = _mm512_shuffle_i32x4(v1, v3, 0xDD);
+    }
+}
+
+// 16x16 tile of 32-bit keys, leaves 8 sorted runs of 32
+template<typename Kernel, typename Ops = typename Kernel::ops>
+struct avx512_16x16_tile
+{
+    using value_type = typename Kernel::value_type;
+    using kernel = Kernel;
+    using reg_type = typename Kernel::reg_type;
+    static constexpr size_t size = 256;
+    static constexpr size_t run = 32;
+
+    SAL_TARGET_AVX512 static void sort(value_type *p)
+    {
+        reg_type r[16];
+        for (size_t i = 0; i < 16; ++i)
+            Kernel::load(p + 16 * i, r[i]);
+
+        sort_columns_avx512<Ops>(r);
+        transpose_avx512_16x16(r);
+
+        for (size_t i = 0; i < 16; i += 2) {
+            reg_type vMin, vMax;
+            Kernel::merge(r[i], r[i + 1], vMin, vMax);
+            Kernel::store(p + 16 * i, vMin);
+            Kernel::store(p + 16 * i + 16, vMax);
+        }
+    }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+// Tile of every tier for key type T, void when the tier has none
+template<typename T, typename Enable = void>
+struct avx2_sort_tile { using type = void; };
+
+template<typename T, typename Enable = void>
+struct avx512_sort_tile { using type = void; };
+
+#ifdef _USE_AVX2_
+template<typename T>
+struct avx2_sort_tile<T, typename std::enable_if<is_int_key<T, 4>::value>::type> {
+    using type = avx2_8x8_tile<avx2_32bit_kernel<T>>;
+};
+
+template<typename T>
+struct avx2_sort_tile<T, typename std::enable_if<is_int_key<T, 8>::value>::type> {
+    using type = avx2_8x4_tile<avx2_64bit_kernel<T>>;
+};
+
+template<>
+struct avx2_sort_tile<float> { using type = avx2_8x8_tile<avx2_float_kernel, avx2_float_ops>; };
+
+template<>
+struct avx2_sort_tile<double> { using type = avx2_8x4_tile<avx2_double_kernel, avx2_double_ops>; };
+#endif
+
+#ifdef _USE_AVX512_
+template<typename T>
+struct avx512_sort_tile<T, typename std::enable_if<is_int_key<T, 4>::value>::type> {
+    using type = avx512_16x16_tile<avx512_32bit_kernel<T>>;
+};
+#endif
+
+// Sorts [first, last) using buffer (at least last - first keys) as the other half of the merge passes
+template<typename Tile>
+inline void tiled_sort(typename Tile::value_type *first, typename Tile::value_type *last,
+                       typename Tile::value_type *buffer)
+{
+    using T = typename Tile::value_type;
+    auto less = [](const T &a, const T &b) { return key_less(a, b); };
+
+    const size_t n = last - first;
+    const size_t tiled = n - n % Tile::size;
+
+    for (size_t i = 0; i < tiled; i += Tile::size)
+        Tile::sort(first + i);
+
+    std::sort(first + tiled, last, less);
+
+    if (tiled == 0)
+        return;
+
+    T *src = first;
+    T *dst = buffer;
+    for (size_t width = Tile::run; width < n; width *= 2) {
+        for (size_t i = 0; i < n; i += 2 * width) {
+            const size_t mid = std::min(i + width, n);
+            const size_t end = std::min(i + 2 * width, n);
+            streaming_merge<typename Tile::kernel>(src + i, src + mid, src + mid, src + end, dst + i);
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != first)
+        std::copy(src, src + n, first);
+}
+
+template<typename T>
+using simd_sort_fn = void (*)(T *, T *, T *);
+
+#ifdef _USE_AVX512_
+template<typename Tile>
+SAL_TARGET_AVX512 SAL_FLATTEN inline void
+avx512_simd_sort(typename Tile::value_type *first, typename Tile::value_type *last, typename Tile::value_type *buffer)
+{
+    tiled_sort<Tile>(first, last, buffer);
+}
+#endif
+
+#ifdef _USE_AVX2_
+template<typename Tile>
+SAL_TARGET_AVX2 SAL_FLATTEN inline void
+avx2_simd_sort(typename Tile::value_type *first, typename Tile::value_type *last, typename Tile::value_type *buffer)
+{
+    tiled_sort<Tile>(first, last, buffer);
+}
+#endif
+
+template<typename T>
+inline void scalar_sort(T *first, T *last, T *)
+{
+    std::sort(first, last, [](const T &a, const T &b) { return key_less(a, b); });
+}
+
+template<typename T, typename Tile>
+struct tier_sort
+{
+#ifdef _USE_AVX512_
+    static simd_sort_fn<T> avx512() { return &avx512_simd_sort<Tile>; }
+#endif
+#ifdef _USE_AVX2_
+    static simd_sort_fn<T> avx2() { return &avx2_simd_sort<Tile>; }
+#endif
+};
+
+template<typename T>
+struct tier_sort<T, void>
+{
+    static simd_sort_fn<T> avx512() { return nullptr; }
+    static simd_sort_fn<T> avx2() { return nullptr; }
+};
+
+template<typename T>
+inline simd_sort_fn<T> select_simd_sort(dispatch::simd_level level)
+{
+    simd_sort_fn<T> fn = nullptr;
+#ifdef _USE_AVX512_
+    if (!fn && level >= dispatch::simd_level::avx512)
+        fn = tier_sort<T, typename avx512_sort_tile<T>::type>::avx512();
+#endif
+#ifdef _USE_AVX2_
+    if (!fn && level >= dispatch::simd_level::avx2)
+        fn = tier_sort<T, typename avx2_sort_tile<T>::type>::avx2();
+#endif
+    (void)level;
+    return fn ? fn : &scalar_sort<T>;
+}
+
+}
+
+// Largest per-thread scratch kept between block sorter calls, the largest tuned leaf of 8-byte keys
+constexpr size_t block_buffer_bytes = size_t(8) << 20;
+
+/**
+ * Scratch of one block sorter call. Blocks up to block_buffer_bytes use a per-thread buffer grown
+ * to the largest such block and kept for the next call; a larger block, e.g. a big sample sort
+ * bucket, gets a buffer of its own that is released when the call returns, so no thread keeps
+ * scratch of the size of the whole input. Slot tells apart buffers of one type a call uses at once.
+ */
+template<typename T, typename Slot>
+class block_buffer {
+public:
+    explicit block_buffer(size_t n)
+    {
+        thread_local aligned_vector<T> cached;
+
+        if (n * sizeof(T) > block_buffer_bytes) {
+            own_.resize(n);
+            data_ = own_.data();
+            return;
+        }
+
+        if (cached.size() < n)
+            cached.resize(n);
+        data_ = cached.data();
+    }
+
+    T *data() const { return data_; }
+
+private:
+    aligned_vector<T> own_;
+    T *data_;
+};
+
+struct value_slot;
+
+template<typename Index, typename KeyIterator, typename ValueIterator, typename Comparator>
+inline void sort_by_key_permutation(KeyIterator first, size_t n, ValueIterator values, Comparator cmp)
+{
+    using K = typename std::iterator_traits<KeyIterator>::value_type;
+    using V = typename std::iterator_traits<ValueIterator>::value_type;
+
+    //keys travel with their positions so the sort compares without indirection
+    block_buffer<std::pair<K, Index>> buffer(n);
+    std::pair<K, Index> *entries = buffer.data();
+    for (size_t i = 0; i < n; ++i)
+        entries[i] = std::make_pair(first[i], Index(i));
+
+    std::sort(entries, entries + n,
+              [&](const std::pair<K, Index> &a, const std::pair<K, Index> &b) { return cmp(a.first, b.first); });
+
+    for (size_t i = 0; i < n; ++i)
+        first[i] = entries[i].first;
+
+    //independent loads, a walk along the cycles of the permutation would wait on every one
+    block_buffer<V, value_slot> gathered(n);
+    V *out = gathered.data();
+    for (size_t i = 0; i < n; ++i)
+        out[i] = std::move(values[entries[i].second]);
+    for (size_t i = 0; i < n; ++i)
+        values[i] = std::move(out[i]);
+}
+
+template<typename KeyIterator, typename ValueIterator, typename Comparator>
+void sort_by_key_permutation(KeyIterator first, KeyIterator last, ValueIterator values, Comparator cmp)
+{
+    const size_t n = std::distance(first, last);
+    if (n <= std::numeric_limits<uint32_t>::max())
+        sort_by_key_permutation<uint32_t>(first, n, values, cmp);
+    else
+        sort_by_key_permutation<size_t>(first, n, values, cmp);
+}
+
+template<typename T>
+inline void sequential_simd_sort(T *first, T *last)
+{
+    static const kernel::simd_sort_fn<T> sort_fn = kernel::select_simd_sort<T>(dispatch::active_simd_level());
+
+    block_buffer<T> buffer(last - first);
+    sort_fn(first, last, buffer.data());
+}
+
+namespace radix {
+
+constexpr unsigned digit_bits = 8;
+constexpr size_t digit_count = size_t(1) << digit_bits;
+
+// Keys are split over chunks of at least this size, one histogram per chunk
+constexpr size_t min_chunk_size = size_t(1) << 16;
+
+using histogram = std::array<size_t, digit_count>;
+
+template<typename T>
+inline size_t digit(const T &v, unsigned pass)
+{
+    return (radix_key<T>::get(v) >> (pass * digit_bits)) & (digit_count - 1);
+}
+
+template<typename T>
+inline void count_digits(const T *first, const T *last, histogram *counts)
+{
+    constexpr unsigned passes = sizeof(typename radix_key<T>::key_type);
+
+    for (unsigned pass = 0; pass < passes; ++pass)
+        counts[pass].fill(0);
+
+    for (; first != last; ++first) {
+        auto key = radix_key<T>::get(*first);
+        for (unsigned pass = 0; pass < passes; ++pass)
+            ++counts[pass][(key >> (pass * digit_bits)) & (digit_count - 1)];
+    }
+}
+
+template<typename T>
+inline void count_digit(const T *first, const T *last, unsigned pass, histogram &counts)
+{
+    counts.fill(0);
+
+    for (; first != last; ++first)
+        ++counts[digit(*first, pass)];
+}
+
+/*
+ * Stable scatter of [first, last) by the digit of the pass, offsets hold the output position of the
+ * next key of every digit. Keys are staged in one cache line per digit and written a line at a
+ * time, so the stream of stores touches 256 lines instead of one random line per key.
+ */
+template<typename T>
+inline void scatter(const T *first, const T *last, T *out, unsigned pass, histogram &offsets)
+{
+    constexpr size_t line = sizeof(T) < 64 ? 64 / sizeof(T) : 1;
+    alignas(64) T staged[digit_count][line];
+    unsigned char fill[digit_count] = {};
+
+    for (; first != last; ++first) {
+        size_t d = digit(*first, pass);
+        staged[d][fill[d]++] = *first;
+
+        if (fill[d] == line) {
+            std::copy(staged[d], staged[d] + line, out + offsets[d]);
+            offsets[d] += line;
+            fill[d] = 0;
+        }
+    }
+
+    for (size_t d = 0; d < digit_count; ++d) {
+        std::copy(staged[d], staged[d] + fill[d], out + offsets[d]);
+        offsets[d] += fill[d];
+    }
+}
+
+template<typename Fun, typename Invoker>
+inline void for_each_chunk(size_t chunks, const Fun &fun, Invoker invoker)
+{
+    if (chunks == 1)
+        fun(size_t(0));
+    else
+        utils::parallel_for(invoker, 0, chunks, fun);
+}
+
+/**
+ * LSD radix sort of n keys using data and buffer alternately as source and destination of the
+ * digit passes, returns whichever of the two holds the sorted keys. Passes whose digit is the same
+ * for all keys are skipped. Every pass splits the keys over `chunks` fixed ranges that are counted
+ * and scattered independently; chunk-minor offsets keep the sort stable.
+ */
+template<typename T, typename Invoker = utils::serial_invoker>
+inline T *sort(T *data, T *buffer, size_t n, size_t chunks, Invoker invoker = Invoker())
+{
+    constexpr unsigned passes = sizeof(typename radix_key<T>::key_type);
+    using chunk_counts = std::array<histogram, passes>;
+
+    chunks = std::max<size_t>(1, std::min(chunks, n / min_chunk_size));
+    auto chunk_first = [&](size_t c) { return n * c / chunks; };
+
+    std::vector<chunk_counts> counts(chunks);
+    for_each_chunk(chunks, [&](size_t c) {
+        count_digits(data + chunk_first(c), data + chunk_first(c + 1), counts[c].data());
+    }, invoker);
+
+    unsigned active[passes];
+    unsigned active_count = 0;
+    for (unsigned pass = 0; pass < passes; ++pass) {
+        bool single_digit = false;
+        for (size_t d = 0; d < digit_count && !single_digit; ++d) {
+            size_t total = 0;
+            for (size_t c = 0; c < chunks; ++c)
+                total += counts[c][pass][d];
+            single_digit = total == n;
+        }
+
+        if (!single_digit)
+            active[active_count++] = pass;
+    }
+
+    std::vector<histogram> offsets(chunks);
+    T *in = data;
+    T *out = buffer;
+
+    for (unsigned i = 0; i < active_count; ++i) {
+        const unsigned pass = active[i];
+
+        //the counts of the first active pass were taken from the initial order, a single chunk
+        //counts the whole range and its counts do not depend on the order
+        if (i > 0 && chunks > 1) {
+            for_each_chunk(chunks, [&](size_t c) {
+                count_digit(in + chunk_first(c), in + chunk_first(c + 1), pass, counts[c][pass]);
+            }, invoker);
+        }
+
+        size_t offset = 0;
+        for (size_t d = 0; d < digit_count; ++d) {
+            for (size_t c = 0; c < chunks; ++c) {
+                offsets[c][d] = offset;
+                offset += counts[c][pass][d];
+            }
+        }
+
+        for_each_chunk(chunks, [&](size_t c) {
+            scatter(in + chunk_first(c), in + chunk_first(c + 1), out, pass, offsets[c]);
+        }, invoker);
+
+        std::swap(in, out);
+    }
+
+    return in;
+}
+
+}
+
+template<typename T>
+inline void sequential_radix_sort(T *first, T *last)
+{
+    const size_t n = last - first;
+    block_buffer<T> buffer(n);
+    T *res = radix::sort(first, buffer.data(), n, 1);
+
+    if (res != first)
+        std::copy(res, res + n, first);
+}
+
+template<typename T, typename Invoker>
+inline T *parallel_radix_sort(T *data, T *buffer, size_t n, Invoker invoker)
+{
+    return radix::sort(data, buffer, n, utils::concurrency(invoker), invoker);
+}
+
+}}}
+
+#endif
@@ -5,7 +5,15 @@
 #ifndef SAL_SORT_HPP
 #define SAL_SORT_HPP
 
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+#include "async.hpp"
 #include "merge.hpp"
+#include "workspace.hpp"
 
 //#define SORT_DEBUG_VERBOSE 1
 
@@ -15,23 +23,172 @@ using namespace merge;
 
 namespace internal {
 
+// Scratch arrays of the sorters, spread over the nodes of the threads of Invoker that merge into them
+// and on huge pages when large, which saves TLB misses in the binary searches of the merges
+template<typename T, typename Invoker = parallel_invoker>
+using scratch_vector = aligned_vector<T, sizeof(T), numa::first_touch_placement<Invoker>, pages::transparent_huge_pages<>>;
+
 struct stable_block_sorter
 {
     template<typename Iterator, typename Comparator>
     void operator()(Iterator first, Iterator last, Comparator cmp)
     {
-        std::stable_sort(first, last, cmp);
+        std::stable_sort(first, last, merge::internal::scalar_order(cmp));
     }
 };
 
 
+// Per-thread scratch of one block sorter call, see sort.cpp
+template<typename T, typename Slot = void>
+class block_buffer;
+
+/**
+ * Sorts a block of keys and the values at the same positions in place: sorts (key, position)
+ * pairs and gathers the values by position, both in per-thread scratch reused across blocks, then
+ * writes keys and values back.
+ */
+template<typename KeyIterator, typename ValueIterator, typename Comparator>
+void sort_by_key_permutation(KeyIterator first, KeyIterator last, ValueIterator values, Comparator cmp);
+
 struct unstable_block_sorter
 {
     template<typename Iterator, typename Comparator>
     void operator()(Iterator first, Iterator last, Comparator cmp)
+    {
+        std::sort(first, last, merge::internal::scalar_order(cmp));
+    }
+
+    template<typename KeyIterator, typename ValueIterator, typename Comparator>
+    void operator()(KeyIterator first, KeyIterator last, ValueIterator values, Comparator cmp)
+    {
+        sort_by_key_permutation(first, last, values, merge::internal::scalar_order(cmp));
+    }
+};
+
+/**
+ * Vectorized sort of a block of 32/64-bit integer, float or double keys: register tiles are sorted
+ * by a bitonic network and a transpose, then merged upward with the streaming merge kernels.
+ * Keys without kernels or hosts below AVX2 use std::sort. Not stable.
+ */
+template<typename T>
+inline void sequential_simd_sort(T *first, T *last);
+
+struct simd_block_sorter
+{
+    template<typename Iterator, typename Comparator>
+    typename std::enable_if<
+            merge::internal::is_simd_key<typename std::iterator_traits<Iterator>::value_type>::value
+    && merge::internal::is_simd_enabled_comparator<Iterator, Comparator>::value
+    >::type operator()(Iterator first, Iterator last, Comparator)
+    {
+        sequential_simd_sort(utils::iterator2pointer(first), utils::iterator2pointer(last));
+    }
+
+    template<typename Iterator, typename Comparator>
+    typename std::enable_if<
+            !merge::internal::is_simd_key<typename std::iterator_traits<Iterator>::value_type>::value ||
+            !merge::internal::is_simd_enabled_comparator<Iterator, Comparator>::value
+    >::type operator()(Iterator first, Iterator last, Comparator cmp)
+    {
+        std::sort(first, last, cmp);
+    }
+
+    template<typename KeyIterator, typename ValueIterator, typename Comparator>
+    void operator()(KeyIterator first, KeyIterator last, ValueIterator values, Comparator cmp)
+    {
+        unstable_block_sorter()(first, last, values, cmp);
+    }
+};
+
+/**
+ * Unsigned radix key of a value type, ordered like std::less for integers. Floating point keys
+ * order NaNs after all numbers and -0.0 before +0.0.
+ */
+template<typename T, typename Enable = void>
+struct radix_key {
+    static constexpr bool value = false;
+};
+
+template<typename T>
+struct radix_key<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+    static constexpr bool value = true;
+    using key_type = typename std::make_unsigned<T>::type;
+
+    static key_type get(const T &v)
+    {
+        const key_type sign = std::is_signed<T>::value ? key_type(key_type(1) << (sizeof(T) * 8 - 1)) : 0;
+        return key_type(key_type(v) ^ sign);
+    }
+};
+
+template<typename T>
+struct radix_key<T, typename std::enable_if<std::is_floating_point<T>::value && sizeof(T) == 4>::type> {
+    static constexpr bool value = true;
+    using key_type = uint32_t;
+
+    static key_type get(const T &v)
+    {
+        key_type bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+
+        if (v != v)
+            return ~key_type(0);
+
+        return (bits >> 31) ? ~bits : bits | 0x80000000u;
+    }
+};
+
+template<typename T>
+struct radix_key<T, typename std::enable_if<std::is_floating_point<T>::value && sizeof(T) == 8>::type> {
+    static constexpr bool value = true;
+    using key_type = uint64_t;
+
+    static key_type get(const T &v)
+    {
+        key_type bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+
+        if (v != v)
+            return ~key_type(0);
+
+        return (bits >> 63) ? ~bits : bits | 0x8000000000000000ull;
+    }
+};
+
+// Stable LSD radix sorts of radix_key types, see sort.cpp
+template<typename T>
+inline void sequential_radix_sort(T *first, T *last);
+
+// Sorts n keys with data and buffer as the two sides of the passes on the tasks of invoker, returns the
+// one holding the result
+template<typename T, typename Invoker>
+inline T *parallel_radix_sort(T *data, T *buffer, size_t n, Invoker invoker);
+
+struct radix_block_sorter
+{
+    template<typename Iterator, typename Comparator>
+    typename std::enable_if<
+            radix_key<typename std::iterator_traits<Iterator>::value_type>::value
+    && merge::internal::is_simd_enabled_comparator<Iterator, Comparator>::value
+    >::type operator()(Iterator first, Iterator last, Comparator)
+    {
+        sequential_radix_sort(utils::iterator2pointer(first), utils::iterator2pointer(last));
+    }
+
+    template<typename Iterator, typename Comparator>
+    typename std::enable_if<
+            !radix_key<typename std::iterator_traits<Iterator>::value_type>::value ||
+            !merge::internal::is_simd_enabled_comparator<Iterator, Comparator>::value
+    >::type operator()(Iterator first, Iterator last, Comparator cmp)
     {
         std::sort(first, last, cmp);
     }
+
+    template<typename KeyIterator, typename ValueIterator, typename Comparator>
+    void operator()(KeyIterator first, KeyIterator last, ValueIterator values, Comparator cmp)
+    {
+        unstable_block_sorter()(first, last, values, cmp);
+    }
 };
 
 template<typename T, typename Comparator = std::less<T>>
@@ -54,6 +211,29 @@ inline void insertion_sort(T* a, size_t a_size, Comparator cmp = Comparator())
     }
 }
 
+template<typename T, typename V, typename Comparator = std::less<T>>
+inline void insertion_sort_by_key(T* a, V* values, size_t a_size, Comparator cmp = Comparator())
+{
+    for ( size_t i = 1; i < a_size; i++ )
+    {
+        if ( cmp(a[ i ], a[ i - 1 ]) )
+        {
+            T currentElement = a[ i ];
+            V currentValue = values[ i ];
+            a[ i ] = a[ i - 1 ];
+            values[ i ] = values[ i - 1 ];
+            size_t j;
+            for ( j = i - 1; j > 0 && cmp(currentElement, a[ j - 1 ]); j-- )
+            {
+                a[ j ] = a[ j - 1 ];
+                values[ j ] = values[ j - 1 ];
+            }
+            a[ j ] = currentElement;
+            values[ j ] = currentValue;
+        }
+    }
+}
+
 struct insertion_sorter
 {
     template<typename Iterator, typename Comparator>
@@ -63,38 +243,320 @@ struct insertion_sorter
         auto a = utils::iterator2pointer(first);
         insertion_sort(a, len, cmp );
     }
+
+    template<typename KeyIterator, typename ValueIterator, typename Comparator>
+    void operator()(KeyIterator first, KeyIterator last, ValueIterator values, Comparator cmp)
+    {
+        size_t len = std::distance(first, last);
+        auto a = utils::iterator2pointer(first);
+        auto v = utils::iterator2pointer(values);
+        insertion_sort_by_key(a, v, len, cmp );
+    }
+};
+
+/**
+ * Implicit search tree over the splitters of a samplesort, stored in breadth-first order.
+ * The bucket of a key is found with log2(buckets) compares whose results feed the index
+ * arithmetic directly, so classification has no data dependent branches.
+ * Bucket b holds the keys in (splitter[b-1], splitter[b]].
+ */
+template<typename T, typename Comparator>
+class splitter_tree {
+public:
+    // buckets must be a power of two, splitters holds buckets - 1 sorted keys
+    splitter_tree(const T* splitters, size_t buckets, Comparator cmp)
+        : tree_(buckets), buckets_(buckets), levels_(0), cmp_(cmp)
+    {
+        while((size_t(1) << levels_) < buckets)
+            ++levels_;
+
+        build(1, splitters);
+    }
+
+    size_t bucket(const T& v) const
+    {
+        size_t j = 1;
+        for(size_t l = 0; l < levels_; ++l)
+            j = 2 * j + size_t(cmp_(tree_[j], v));
+
+        return j - buckets_;
+    }
+
+    // Classifies `batch` keys at once, the independent tree walks overlap their compare latencies
+    template<size_t batch>
+    void buckets(const T* v, size_t* res) const
+    {
+        size_t j[batch];
+        for(size_t u = 0; u < batch; ++u)
+            j[u] = 1;
+
+        for(size_t l = 0; l < levels_; ++l)
+            for(size_t u = 0; u < batch; ++u)
+                j[u] = 2 * j[u] + size_t(cmp_(tree_[j[u]], v[u]));
+
+        for(size_t u = 0; u < batch; ++u)
+            res[u] = j[u] - buckets_;
+    }
+
+    // Calls fun(key, bucket) for every key of [first, last) in order
+    template<typename Fun>
+    void classify(const T* first, const T* last, Fun fun) const
+    {
+        constexpr size_t batch = 8;
+        size_t b[batch];
+
+        for(; last - first >= (std::ptrdiff_t)batch; first += batch)
+        {
+            buckets<batch>(first, b);
+            for(size_t u = 0; u < batch; ++u)
+                fun(first[u], b[u]);
+        }
+
+        for(; first != last; ++first)
+            fun(*first, bucket(*first));
+    }
+
+private:
+    void build(size_t j, const T*& splitters)
+    {
+        if(j >= buckets_)
+            return;
+
+        build(2 * j, splitters);
+        tree_[j] = *splitters++;
+        build(2 * j + 1, splitters);
+    }
+
+    aligned_vector<T> tree_;
+    size_t buckets_;
+    size_t levels_;
+    Comparator cmp_;
+};
+
+enum class run_order {
+    ascending,
+    descending,
+    unsorted
+};
+
+// Run [first, last) of a natural merge sort, descending runs are strictly descending
+struct natural_run {
+    size_t first;
+    size_t last;
+    run_order order;
 };
 
+/**
+ * Appends the maximal runs of a[first, last). Ascending runs keep equal keys, so reversing a
+ * descending one is stable. Consecutive runs shorter than min_length are collected into unsorted
+ * runs of min_length to 2 * min_length keys, which are left to a block sorter.
+ */
+template<typename T, typename Comparator>
+void find_runs(const T* a, size_t first, size_t last, size_t min_length, std::vector<natural_run>& runs, Comparator cmp)
+{
+    size_t i = first;
+    while(i < last)
+    {
+        size_t j = i + 1;
+        const bool descending = j < last && cmp(a[j], a[i]);
+
+        if(descending)
+            while(j < last && cmp(a[j], a[j - 1]))
+                ++j;
+        else
+            while(j < last && !cmp(a[j], a[j - 1]))
+                ++j;
+
+        if(j - i >= min_length)
+            runs.push_back({i, j, descending ? run_order::descending : run_order::ascending});
+        else if(!runs.empty() && runs.back().order == run_order::unsorted && runs.back().last == i &&
+                runs.back().last - runs.back().first < min_length)
+            runs.back().last = j;
+        else
+            runs.push_back({i, j, run_order::unsorted});
+
+        i = j;
+    }
+}
+
+/**
+ * Powersort node power of the boundary between the adjacent runs [s1, s1 + n1) and [s1 + n1, s1 + n1 + n2)
+ * of an array of n keys: the first bit in which the binary fractions of the run midpoints differ.
+ * Boundaries with lower power are merged later, which keeps the merge tree nearly optimal.
+ */
+inline size_t run_power(size_t s1, size_t n1, size_t n2, size_t n)
+{
+    const size_t total = 2 * n;
+    size_t a = 2 * s1 + n1;
+    size_t b = a + n1 + n2;
+    size_t power = 0;
+
+    for(;;)
+    {
+        ++power;
+        a *= 2;
+        b *= 2;
+
+        if(a < total && b >= total)
+            return power;
+
+        if(a >= total)
+        {
+            a -= total;
+            b -= total;
+        }
+    }
+}
+
 }
 
-template<typename T, typename Invoker = parallel_invoker, size_t block_size = 8192, typename MergerSettings = default_merger_settings>
+// block_size of a sorter that takes its leaf size from the tuning of its element type and merger, see tuning.hpp
+constexpr size_t tuned_block_size = 0;
+
+// LeafSorter sorts the leaf blocks of the unstable sorts, stable_merge_sort always uses stable_block_sorter
+template<typename T, typename Invoker = parallel_invoker, size_t block_size = 8192, typename MergerSettings = default_merger_settings,
+         typename LeafSorter = internal::simd_block_sorter>
 class sorter {
 public:
-    using merger_type = merger<T, Invoker, typename MergerSettings::merger_type, typename MergerSettings::partitioner_type>;
+    using invoker_type = Invoker;
+    using stats_type = typename MergerSettings::stats_type;
+    using merger_type = merger<T, Invoker, typename MergerSettings::merger_type, typename MergerSettings::partitioner_type,
+                               stats_type>;
 
-    template<typename Iterator, typename Comparator = std::less<int>>
+    template<typename Iterator, typename Comparator = std::less<T>>
     static void merge_sort(Iterator first, Iterator last, Comparator cmp = Comparator());
 
-    template<typename Iterator, typename Comparator = std::less<int>>
+    template<typename Iterator, typename Comparator = std::less<T>>
     static void merge_sort(Iterator first, Iterator last, Iterator out, Comparator cmp = Comparator());
 
-    template<typename Iterator, typename Comparator = std::less<int>>
+    template<typename Iterator, typename Comparator = std::less<T>>
     static void stable_merge_sort(Iterator first, Iterator last, Iterator out, Comparator cmp = Comparator());
 
-    template<typename Iterator, typename Comparator = std::less<int>>
+    template<typename Iterator, typename Comparator = std::less<T>>
     static void stable_merge_sort(Iterator first, Iterator last, Comparator cmp = Comparator());
 
+    // Sorts the keys and applies the same permutation to the parallel value array.
+    // Equal keys are not guaranteed to keep their input order.
+    template<typename Iterator, typename ValueIterator, typename Comparator = std::less<T>>
+    static void merge_sort_by_key(Iterator first, Iterator last, ValueIterator values, Comparator cmp = Comparator());
+
+    template<typename Iterator, typename ValueIterator, typename Comparator = std::less<T>>
+    static void merge_sort_by_key(Iterator first, Iterator last, ValueIterator values,
+                                  Iterator out, ValueIterator out_values, Comparator cmp = Comparator());
+
+    // Samplesort: partitioning passes into buckets by oversampled splitters, as many as n needs to
+    // reach leaf sized buckets, then every bucket is sorted independently by the block sorter. Keys
+    // equal to a repeated splitter get a bucket of their own that needs no sort. Not stable.
+    template<typename Iterator, typename Comparator = std::less<T>>
+    static void sample_sort(Iterator first, Iterator last, Comparator cmp = Comparator());
+
+    // The input range is used as scratch
+    template<typename Iterator, typename Comparator = std::less<T>>
+    static void sample_sort(Iterator first, Iterator last, Iterator out, Comparator cmp = Comparator());
+
+    // Multiway merge sort: cache-sized leaf blocks are sorted independently and then combined by
+    // as few high fan-in tournament merge rounds as possible, usually one or two, so the data
+    // crosses memory about three times regardless of its size. Not stable.
+    template<typename Iterator, typename Comparator = std::less<T>>
+    static void multiway_merge_sort(Iterator first, Iterator last, Comparator cmp = Comparator());
+
+    // The input range is used as scratch
+    template<typename Iterator, typename Comparator = std::less<T>>
+    static void multiway_merge_sort(Iterator first, Iterator last, Iterator out, Comparator cmp = Comparator());
+
+    // Natural merge sort: maximal ascending and strictly descending runs are found in parallel, short
+    // runs are collected into blocks for the block sorter and the runs are merged in powersort order.
+    // Sorted input costs one scan and input made of k runs O(n log k). Not stable.
+    template<typename Iterator, typename Comparator = std::less<T>>
+    static void natural_merge_sort(Iterator first, Iterator last, Comparator cmp = Comparator());
+
+    // The input range is used as scratch
+    template<typename Iterator, typename Comparator = std::less<T>>
+    static void natural_merge_sort(Iterator first, Iterator last, Iterator out, Comparator cmp = Comparator());
+
+    // Overloads of the in-place sorts that take their scratch memory from a workspace kept by the
+    // caller, so repeated sorts do not allocate. Keys and values must be trivially copyable.
+    template<typename Iterator, typename Comparator = std::less<T>>
+    static void merge_sort(Iterator first, Iterator last, sort_workspace& workspace, Comparator cmp = Comparator());
+
+    template<typename Iterator, typename Comparator = std::less<T>>
+    static void stable_merge_sort(Iterator first, Iterator last, sort_workspace& workspace, Comparator cmp = Comparator());
+
+    template<typename Iterator, typename ValueIterator, typename Comparator = std::less<T>>
+    static void merge_sort_by_key(Iterator first, Iterator last, ValueIterator values, sort_workspace& workspace,
+                                  Comparator cmp = Comparator());
+
+    template<typename Iterator, typename Comparator = std::less<T>>
+    static void sample_sort(Iterator first, Iterator last, sort_workspace& workspace, Comparator cmp = Comparator());
+
+    template<typename Iterator, typename Comparator = std::less<T>>
+    static void multiway_merge_sort(Iterator first, Iterator last, sort_workspace& workspace, Comparator cmp = Comparator());
+
+    template<typename Iterator, typename Comparator = std::less<T>>
+    static void natural_merge_sort(Iterator first, Iterator last, sort_workspace& workspace, Comparator cmp = Comparator());
+
+    // merge_sort in the background on the scheduler of Invoker, its pool for pool_invoker and TBB
+    // otherwise: returns at once, sorts up to async_runs runs one per phase and merges them one
+    // level per phase. Cancelling stops it between phases with the range permuted. The range must
+    // stay valid until the handle is ready.
+    template<typename Iterator, typename Comparator = std::less<T>>
+    static async::handle merge_sort_async(Iterator first, Iterator last, Comparator cmp = Comparator());
 
 private:
+    static constexpr size_t async_runs = 8;
+    static constexpr size_t sample_oversampling = 16;
+    static constexpr size_t sample_max_buckets = 256;
+    static constexpr unsigned sample_max_depth = 8;
+    static constexpr size_t multiway_leaf_bytes = 512 * 1024;
+    static constexpr size_t multiway_max_fan_in = 128;
+
+    // block_size, or the value tuned for T and the merger when block_size is tuned_block_size
+    static size_t _leaf_size()
+    {
+        return block_size ? block_size : tuning::values<T, typename MergerSettings::merger_type>().leaf_size;
+    }
+
+    template<typename BlockSorter, typename Comparator>
+    static void _multiway_merge_sort_common(T* src, T* buffer, size_t n, bool into_src, Comparator cmp,
+                                            BlockSorter block_sorter = BlockSorter());
+
+    template<typename BlockSorter, typename Comparator>
+    static void _sample_sort_common(T* src, T* buffer, size_t n, bool into_src, Comparator cmp,
+                                    BlockSorter block_sorter = BlockSorter(), unsigned depth = 0);
+
+    template<typename BlockSorter, typename Comparator>
+    static void _natural_merge_sort_common(T* src, T* buffer, size_t n, bool into_src, Comparator cmp,
+                                           BlockSorter block_sorter = BlockSorter());
+
+    template<typename Comparator>
+    static void _natural_merge(T* src, T* buffer, const size_t* bounds, const size_t* powers, size_t i, size_t j,
+                               bool into_buffer, Comparator cmp, Invoker invoker = Invoker());
+
     template<typename BlockSorter, typename Comparator>
     static void _merge_sort_common(T* src, size_t l, size_t r, T* dest, bool src2dest, Comparator cmp,
-                                   BlockSorter block_sorter = BlockSorter(), Invoker invoker = Invoker());
+                                   BlockSorter block_sorter = BlockSorter(), Invoker invoker = Invoker(),
+                                   unsigned depth = 0);
+
+    template<typename V, typename BlockSorter, typename Comparator>
+    static void _merge_sort_common_by_key(T* src, V* src_values, size_t l, size_t r, T* dest, V* dest_values,
+                                          bool src2dest, Comparator cmp,
+                                          BlockSorter block_sorter = BlockSorter(), Invoker invoker = Invoker(),
+                                          unsigned depth = 0);
 
 };
 
-template<typename T, typename Invoker, size_t block_size, typename MergerSettings>
+// Sorter whose leaf size, merge block size and merge cutoff follow the tuning of T on this host
+template<typename T, typename Invoker = parallel_invoker>
+using tuned_sorter = sorter<T, Invoker, tuned_block_size, tuned_merger_settings<T>>;
+
+// Sorter whose leaf blocks are sorted by LSD radix sort, for integer, float and double keys under the
+// default order; other keys and comparators fall back to std::sort
+template<typename T, typename Invoker = parallel_invoker>
+using radix_leaf_sorter = sorter<T, Invoker, 8192, default_merger_settings, internal::radix_block_sorter>;
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
 template<typename Iterator, typename Comparator>
-void sorter<T, Invoker, block_size, MergerSettings>::merge_sort(Iterator first, Iterator last, Comparator cmp)
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::merge_sort(Iterator first, Iterator last, Comparator cmp)
 {
     static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
                   "Specified type must be the same as type of iterators");
@@ -105,17 +567,17 @@ void sorter<T, Invoker, block_size, MergerSettings>::merge_sort(Iterator first,
     if(n < 2)
         return;
 
-    aligned_vector<T> tmp_buffer;
+    internal::scratch_vector<T, Invoker> tmp_buffer;
     tmp_buffer.resize(n);
 
     auto src = utils::iterator2pointer(first);
 
-    _merge_sort_common(src, 0, n-1, tmp_buffer.data(), false, cmp, internal::unstable_block_sorter());
+    _merge_sort_common(src, 0, n-1, tmp_buffer.data(), false, cmp, LeafSorter());
 }
 
-template<typename T, typename Invoker, size_t block_size, typename MergerSettings>
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
 template<typename Iterator, typename Comparator>
-void sorter<T, Invoker, block_size, MergerSettings>::merge_sort(Iterator first, Iterator last, Iterator out, Comparator cmp)
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::merge_sort(Iterator first, Iterator last, Iterator out, Comparator cmp)
 {
     static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
                   "Specified type must be the same as type of iterators");
@@ -126,12 +588,12 @@ void sorter<T, Invoker, block_size, MergerSettings>::merge_sort(Iterator first,
     auto src = utils::iterator2pointer(first);
     auto outp = utils::iterator2pointer(out);
 
-    _merge_sort_common(src, 0, n-1, outp, true, cmp, internal::unstable_block_sorter());
+    _merge_sort_common(src, 0, n-1, outp, true, cmp, LeafSorter());
 }
 
-template<typename T, typename Invoker, size_t block_size, typename MergerSettings>
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
 template<typename Iterator, typename Comparator>
-void sorter<T, Invoker, block_size, MergerSettings>::stable_merge_sort(Iterator first, Iterator last, Iterator out, Comparator cmp)
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::stable_merge_sort(Iterator first, Iterator last, Iterator out, Comparator cmp)
 {
     static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
                   "Specified type must be the same as type of iterators");
@@ -145,9 +607,9 @@ void sorter<T, Invoker, block_size, MergerSettings>::stable_merge_sort(Iterator
     _merge_sort_common(src, 0, n-1, outp, true, cmp, internal::stable_block_sorter());
 }
 
-template<typename T, typename Invoker, size_t block_size, typename MergerSettings>
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
 template<typename Iterator, typename Comparator>
-void sorter<T, Invoker, block_size, MergerSettings>::stable_merge_sort(Iterator first, Iterator last, Comparator cmp)
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::stable_merge_sort(Iterator first, Iterator last, Comparator cmp)
 {
     static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
                   "Specified type must be the same as type of iterators");
@@ -158,7 +620,7 @@ void sorter<T, Invoker, block_size, MergerSettings>::stable_merge_sort(Iterator
     if(n < 2)
         return;
 
-    aligned_vector<T> tmp_buffer;
+    internal::scratch_vector<T, Invoker> tmp_buffer;
     tmp_buffer.resize(n);
 
     auto src = utils::iterator2pointer(first);
@@ -166,41 +628,884 @@ void sorter<T, Invoker, block_size, MergerSettings>::stable_merge_sort(Iterator
     _merge_sort_common(src, 0, n-1, tmp_buffer.data(), false, cmp, internal::stable_block_sorter());
 }
 
-template<typename T, typename Invoker, size_t block_size, typename MergerSettings>
-template<typename BlockSorter, typename Comparator>
-void sorter<T, Invoker, block_size, MergerSettings>::_merge_sort_common(T* src, size_t l, size_t r, T* dest, bool src2dest, Comparator cmp,
-                                                                        BlockSorter block_sorter, Invoker invoker)
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename ValueIterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::merge_sort_by_key(Iterator first, Iterator last, ValueIterator values,
+                                                                       Comparator cmp)
 {
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value && is_random_access_iterator<ValueIterator>::value,
+                  "Iterators must be of random-access iterator type");
 
-    if(r == l)
-    {
-        if(src2dest)
-            dest[l] = src[l];
+    using V = typename std::iterator_traits<ValueIterator>::value_type;
 
+    long long n = std::distance(first, last);
+    if(n < 2)
         return;
-    }
 
-    if((r-l) <= block_size && !src2dest)
-    {
-        block_sorter(src+l, src+r+1, cmp);
+    internal::scratch_vector<T, Invoker> tmp_buffer;
+    tmp_buffer.resize(n);
+    internal::scratch_vector<V, Invoker> tmp_values;
+    tmp_values.resize(n);
+
+    auto src = utils::iterator2pointer(first);
+    auto src_values = utils::iterator2pointer(values);
+
+    _merge_sort_common_by_key(src, src_values, 0, n-1, tmp_buffer.data(), tmp_values.data(), false, cmp,
+                              internal::unstable_block_sorter());
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename ValueIterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::merge_sort_by_key(Iterator first, Iterator last, ValueIterator values,
+                                                                       Iterator out, ValueIterator out_values,
+                                                                       Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value && is_random_access_iterator<ValueIterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 1)
         return;
-    }
 
-    size_t m = (r + l) / 2;
+    auto src = utils::iterator2pointer(first);
+    auto src_values = utils::iterator2pointer(values);
+    auto outp = utils::iterator2pointer(out);
+    auto out_valuesp = utils::iterator2pointer(out_values);
 
-    invoker(
-            [&]{_merge_sort_common(src, l, m, dest, !src2dest, cmp, block_sorter, invoker);},
-            [&]{_merge_sort_common(src, m +1, r, dest, !src2dest, cmp, block_sorter, invoker);}
-    );
+    _merge_sort_common_by_key(src, src_values, 0, n-1, outp, out_valuesp, true, cmp,
+                              internal::unstable_block_sorter());
+}
 
-    if(src2dest)
-        merger_type::merge(src, l, m, m+1, r, dest, l, cmp);
-    else
-        merger_type::merge(dest, l, m, m+1, r, src, l, cmp);
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::sample_sort(Iterator first, Iterator last, Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 2)
+        return;
+
+    internal::scratch_vector<T, Invoker> tmp_buffer;
+    tmp_buffer.resize(n);
 
+    auto src = utils::iterator2pointer(first);
 
+    _sample_sort_common(src, tmp_buffer.data(), n, true, cmp, LeafSorter());
 }
 
-}}
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::sample_sort(Iterator first, Iterator last, Iterator out, Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 1)
+        return;
+
+    auto src = utils::iterator2pointer(first);
+    auto outp = utils::iterator2pointer(out);
+
+    _sample_sort_common(src, outp, n, false, cmp, LeafSorter());
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::merge_sort(Iterator first, Iterator last, sort_workspace& workspace,
+                                                                Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 2)
+        return;
+
+    auto src = utils::iterator2pointer(first);
+
+    _merge_sort_common(src, 0, n-1, workspace.scratch<T>(n, Invoker()), false, cmp, LeafSorter());
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::stable_merge_sort(Iterator first, Iterator last, sort_workspace& workspace,
+                                                                       Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 2)
+        return;
+
+    auto src = utils::iterator2pointer(first);
+
+    _merge_sort_common(src, 0, n-1, workspace.scratch<T>(n, Invoker()), false, cmp, internal::stable_block_sorter());
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename ValueIterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::merge_sort_by_key(Iterator first, Iterator last, ValueIterator values,
+                                                                       sort_workspace& workspace, Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value && is_random_access_iterator<ValueIterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    using V = typename std::iterator_traits<ValueIterator>::value_type;
+
+    long long n = std::distance(first, last);
+    if(n < 2)
+        return;
+
+    auto tmp = workspace.scratch<T, V>(n, Invoker());
+    auto src = utils::iterator2pointer(first);
+    auto src_values = utils::iterator2pointer(values);
+
+    _merge_sort_common_by_key(src, src_values, 0, n-1, tmp.first, tmp.second, false, cmp,
+                              internal::unstable_block_sorter());
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::sample_sort(Iterator first, Iterator last, sort_workspace& workspace,
+                                                                 Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 2)
+        return;
+
+    auto src = utils::iterator2pointer(first);
+
+    _sample_sort_common(src, workspace.scratch<T>(n, Invoker()), n, true, cmp, LeafSorter());
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::multiway_merge_sort(Iterator first, Iterator last, sort_workspace& workspace,
+                                                                         Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 2)
+        return;
+
+    auto src = utils::iterator2pointer(first);
+
+    _multiway_merge_sort_common(src, workspace.scratch<T>(n, Invoker()), n, true, cmp, LeafSorter());
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::natural_merge_sort(Iterator first, Iterator last, sort_workspace& workspace,
+                                                                        Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 2)
+        return;
+
+    auto src = utils::iterator2pointer(first);
+
+    _natural_merge_sort_common(src, workspace.scratch<T>(n, Invoker()), n, true, cmp, LeafSorter());
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename Comparator>
+async::handle sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::merge_sort_async(Iterator first, Iterator last, Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    const size_t n = std::distance(first, last);
+    T* src = n ? utils::iterator2pointer(first) : nullptr;
+
+    size_t runs = 1;
+    while(runs < async_runs && n / (2 * runs) > _leaf_size())
+        runs *= 2;
+
+    //allocated by the first phase, so the caller does not wait for it
+    auto buffer = std::make_shared<internal::scratch_vector<T, Invoker>>();
+
+    return async::internal::start([=](size_t phase) -> bool
+    {
+        if(n < 2)
+            return false;
+
+        if(phase < runs)
+        {
+            if(phase == 0)
+                buffer->resize(n);
+
+            const size_t l = n * phase / runs;
+            const size_t r = n * (phase + 1) / runs - 1;
+            _merge_sort_common(src, l, r, buffer->data(), false, cmp, LeafSorter());
+            return runs > 1;
+        }
+
+        //level k merges pairs of 2^k sorted runs, from src into the buffer and back
+        const size_t level = phase - runs;
+        const size_t width = size_t(1) << level;
+        const size_t groups = runs / (2 * width);
+        T* from = level % 2 ? buffer->data() : src;
+        T* to = level % 2 ? src : buffer->data();
+
+        utils::parallel_for(Invoker(), 0, groups, [&](size_t g)
+        {
+            const size_t l = n * (2 * g * width) / runs;
+            const size_t m = n * ((2 * g + 1) * width) / runs;
+            const size_t r = n * (2 * (g + 1) * width) / runs - 1;
+            merger_type::merge(from, l, m - 1, m, r, to, l, cmp);
+        });
+
+        if(groups > 1)
+            return true;
+
+        if(to != src)
+        {
+            SAL_PERF_SCOPE(copy, perf::phase::copy());
+            std::copy(to, to + n, src);
+        }
+
+        return false;
+    }, async::internal::queue_of(Invoker()));
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename BlockSorter, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::_sample_sort_common(T* src, T* buffer, size_t n, bool into_src,
+                                                                         Comparator cmp, BlockSorter block_sorter,
+                                                                         unsigned depth)
+{
+    const size_t leaf_size = _leaf_size();
+
+    if(n <= 2 * leaf_size)
+    {
+        if(!into_src)
+        {
+            std::copy(src, src + n, buffer);
+            src = buffer;
+        }
+
+        block_sorter(src, src + n, cmp);
+        return;
+    }
+
+    //as few levels of at most sample_max_buckets buckets as reach leaf sized buckets, then as few buckets per level as do
+    const size_t leaves = (n + leaf_size - 1) / leaf_size;
+    size_t levels = 1;
+    for(size_t reach = sample_max_buckets; reach < leaves; reach *= sample_max_buckets)
+        ++levels;
+
+    auto power = [levels](size_t b) {
+        size_t r = 1;
+        for(size_t l = 0; l < levels; ++l)
+            r *= b;
+        return r;
+    };
+
+    size_t buckets = 2;
+    while(buckets < sample_max_buckets && power(buckets) < leaves)
+        buckets *= 2;
+
+    //every oversampling-th key of a sorted random sample becomes a splitter
+    std::vector<T> sample;
+    sample.reserve(buckets * sample_oversampling);
+    std::mt19937_64 rng(n + depth);
+    std::uniform_int_distribution<size_t> position(0, n - 1);
+    for(size_t i = 0; i < buckets * sample_oversampling; ++i)
+        sample.push_back(src[position(rng)]);
+
+    //std::less of float and double is the NaN-last order of the kernels here as well
+    auto order = merge::internal::scalar_order(cmp);
+    std::sort(sample.begin(), sample.end(), order);
+
+    //repeated splitters are dropped, the keys equal to them go to equality buckets instead
+    std::vector<T> splitters;
+    splitters.reserve(buckets - 1);
+    for(size_t i = 1; i < buckets; ++i)
+    {
+        const T& s = sample[i * sample_oversampling - 1];
+        if(splitters.empty() || order(splitters.back(), s))
+            splitters.push_back(s);
+    }
+
+    //padding repeats the largest splitter, its buckets stay empty
+    buckets = 2;
+    while(buckets - 1 < splitters.size())
+        buckets *= 2;
+    splitters.resize(buckets - 1, splitters.back());
+
+    const internal::splitter_tree<T, decltype(order)> tree(splitters.data(), buckets, order);
+
+    //bucket 2b holds the keys in (splitter[b-1], splitter[b]), bucket 2b+1 the keys equal to splitter[b]
+    const size_t classes = 2 * buckets;
+    auto class_of = [&](const T& v, size_t b) {
+        return 2 * b + size_t(b + 1 < buckets && !order(v, splitters[b]));
+    };
+
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>(utils::concurrency(Invoker()), n / leaf_size));
+    auto chunk_first = [&](size_t c) { return n * c / chunks; };
+
+    std::vector<size_t> counts(chunks * classes, 0);
+    utils::parallel_for(Invoker(), 0, chunks, [&](size_t c) {
+        size_t* chunk_counts = &counts[c * classes];
+        tree.classify(src + chunk_first(c), src + chunk_first(c + 1),
+                      [&](const T& v, size_t b) { ++chunk_counts[class_of(v, b)]; });
+    });
+
+    //class-major, chunk-minor offsets
+    std::vector<size_t> class_first(classes + 1);
+    size_t offset = 0;
+    for(size_t b = 0; b < classes; ++b)
+    {
+        class_first[b] = offset;
+        for(size_t c = 0; c < chunks; ++c)
+        {
+            size_t count = counts[c * classes + b];
+            counts[c * classes + b] = offset;
+            offset += count;
+        }
+    }
+    class_first[classes] = n;
+
+    utils::parallel_for(Invoker(), 0, chunks, [&](size_t c) {
+        size_t* chunk_offsets = &counts[c * classes];
+        tree.classify(src + chunk_first(c), src + chunk_first(c + 1),
+                      [&](const T& v, size_t b) { buffer[chunk_offsets[class_of(v, b)]++] = v; });
+    });
+
+    //equality buckets are sorted already; a bucket too large for a leaf is split again with the roles
+    //of src and buffer swapped, past sample_max_depth the block sorter takes it as it is
+    utils::parallel_for(Invoker(), 0, classes, [&](size_t b) {
+        T* first = buffer + class_first[b];
+        T* last = buffer + class_first[b + 1];
+        const size_t size = last - first;
+
+        if(b % 2 == 0 && size > 2 * leaf_size && depth < sample_max_depth)
+        {
+            _sample_sort_common(first, src + class_first[b], size, !into_src, cmp, block_sorter, depth + 1);
+            return;
+        }
+
+        if(b % 2 == 0)
+            block_sorter(first, last, cmp);
+
+        if(into_src)
+            std::copy(first, last, src + class_first[b]);
+    });
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::multiway_merge_sort(Iterator first, Iterator last, Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 2)
+        return;
+
+    internal::scratch_vector<T, Invoker> tmp_buffer;
+    tmp_buffer.resize(n);
+
+    auto src = utils::iterator2pointer(first);
+
+    _multiway_merge_sort_common(src, tmp_buffer.data(), n, true, cmp, LeafSorter());
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::multiway_merge_sort(Iterator first, Iterator last, Iterator out,
+                                                                         Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 1)
+        return;
+
+    auto src = utils::iterator2pointer(first);
+    auto outp = utils::iterator2pointer(out);
+
+    _multiway_merge_sort_common(src, outp, n, false, cmp, LeafSorter());
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename BlockSorter, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::_multiway_merge_sort_common(T* src, T* buffer, size_t n, bool into_src,
+                                                                                 Comparator cmp, BlockSorter block_sorter)
+{
+    const size_t leaf = std::max<size_t>(_leaf_size(), multiway_leaf_bytes / sizeof(T));
+
+    if(n <= leaf)
+    {
+        SAL_PERF_SCOPE(phase, perf::phase::leaf_sort());
+        if(!into_src)
+        {
+            std::copy(src, src + n, buffer);
+            src = buffer;
+        }
+
+        block_sorter(src, src + n, cmp);
+        return;
+    }
+
+    //fewest rounds the fan-in limit allows, then the smallest fan-in that still fits them
+    const size_t runs = (n + leaf - 1) / leaf;
+    size_t rounds = 1;
+    for(size_t reach = multiway_max_fan_in; reach < runs; reach *= multiway_max_fan_in)
+        ++rounds;
+
+    auto reach = [rounds](size_t fan_in) {
+        size_t r = 1;
+        for(size_t i = 0; i < rounds; ++i)
+            r *= fan_in;
+        return r;
+    };
+
+    size_t fan_in = std::max<size_t>(2, (size_t) std::ceil(std::pow((double) runs, 1.0 / rounds)));
+    while(fan_in > 2 && reach(fan_in - 1) >= runs)
+        --fan_in;
+    while(reach(fan_in) < runs)
+        ++fan_in;
+
+    //leaves are placed so that the last round writes into the requested array
+    T* dest = into_src ? src : buffer;
+    T* other = into_src ? buffer : src;
+    T* from = rounds % 2 == 0 ? dest : other;
+    T* to = rounds % 2 == 0 ? other : dest;
+
+    utils::parallel_for(Invoker(), 0, runs, [&](size_t b) {
+        SAL_PERF_SCOPE(phase, perf::phase::leaf_sort());
+        const auto started = stats_type::start();
+        const size_t first = b * leaf;
+        const size_t last = std::min(n, first + leaf);
+
+        if(from != src)
+            std::copy(src + first, src + last, from + first);
+
+        block_sorter(from + first, from + last, cmp);
+        stats_type::leaf(last - first, rounds, started);
+    });
+
+    //a group is merged in slices on the Invoker of the sorter, sized by the partitioner of its merger settings
+    using group_merger = kway_merger<T, typename MergerSettings::partitioner_type, Invoker>;
+
+    unsigned level = 0;
+    for(size_t run_size = leaf; run_size < n; run_size *= fan_in, ++level)
+    {
+        const size_t group_size = run_size * fan_in;
+        const size_t groups = (n + group_size - 1) / group_size;
+
+        utils::parallel_for(Invoker(), 0, groups, [&](size_t g) {
+            SAL_PERF_SCOPE(phase, perf::phase::merge(level));
+            const auto started = stats_type::start();
+            const size_t group_first = g * group_size;
+            const size_t group_last = std::min(n, group_first + group_size);
+
+            std::vector<merge::internal::sorted_run<T>> group_runs;
+            group_runs.reserve(fan_in);
+            for(size_t i = group_first; i < group_last; i += run_size)
+                group_runs.emplace_back(from + i, from + std::min(group_last, i + run_size));
+
+            group_merger::merge(group_runs.data(), group_runs.size(), to + group_first, cmp);
+            stats_type::merge(rounds - 1 - level, group_last - group_first, (group_last - group_first) * sizeof(T), started);
+        });
+
+        std::swap(from, to);
+    }
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::natural_merge_sort(Iterator first, Iterator last, Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 2)
+        return;
+
+    //the buffer is allocated only when the input has more than one run
+    auto src = utils::iterator2pointer(first);
+
+    _natural_merge_sort_common(src, nullptr, n, true, cmp, LeafSorter());
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Iterator, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::natural_merge_sort(Iterator first, Iterator last, Iterator out,
+                                                                        Comparator cmp)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 1)
+        return;
+
+    auto src = utils::iterator2pointer(first);
+    auto outp = utils::iterator2pointer(out);
+
+    _natural_merge_sort_common(src, outp, n, false, cmp, LeafSorter());
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename BlockSorter, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::_natural_merge_sort_common(T* src, T* buffer, size_t n, bool into_src,
+                                                                                Comparator cmp, BlockSorter block_sorter)
+{
+    using internal::natural_run;
+    using internal::run_order;
+
+    const size_t leaf_size = _leaf_size();
+
+    //runs are found per chunk and joined across chunk boundaries afterwards
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>(4 * utils::concurrency(Invoker()), n / leaf_size));
+    std::vector<std::vector<natural_run>> chunk_runs(chunks);
+    auto order = merge::internal::scalar_order(cmp);
+
+    utils::parallel_for(Invoker(), 0, chunks, [&](size_t c) {
+        internal::find_runs(src, n * c / chunks, n * (c + 1) / chunks, leaf_size, chunk_runs[c], order);
+    });
+
+    std::vector<natural_run> runs;
+    for(auto& chunk : chunk_runs)
+    {
+        for(auto& run : chunk)
+        {
+            bool joins = false;
+            if(!runs.empty() && runs.back().order == run.order)
+            {
+                const T& prev = src[run.first - 1];
+                const T& next = src[run.first];
+
+                switch(run.order)
+                {
+                    case run_order::ascending: joins = !order(next, prev); break;
+                    case run_order::descending: joins = order(next, prev); break;
+                    case run_order::unsorted: joins = runs.back().last - runs.back().first < leaf_size; break;
+                }
+            }
+
+            if(joins)
+                runs.back().last = run.last;
+            else
+                runs.push_back(run);
+        }
+    }
+
+    utils::parallel_for(Invoker(), 0, runs.size(), [&](size_t r) {
+        SAL_PERF_SCOPE(phase, perf::phase::leaf_sort());
+        if(runs[r].order == run_order::descending)
+            std::reverse(src + runs[r].first, src + runs[r].last);
+        else if(runs[r].order == run_order::unsorted)
+            block_sorter(src + runs[r].first, src + runs[r].last, cmp);
+    });
+
+    std::vector<size_t> bounds;
+    bounds.reserve(runs.size() + 1);
+    for(auto& run : runs)
+        bounds.push_back(run.first);
+    bounds.push_back(n);
+
+    const size_t k = bounds.size() - 1;
+    if(k == 1)
+    {
+        SAL_PERF_SCOPE(phase, perf::phase::copy());
+        if(!into_src)
+            std::copy(src, src + n, buffer);
+
+        return;
+    }
+
+    std::vector<size_t> powers(k - 1);
+    for(size_t r = 0; r + 1 < k; ++r)
+        powers[r] = internal::run_power(bounds[r], bounds[r + 1] - bounds[r], bounds[r + 2] - bounds[r + 1], n);
+
+    internal::scratch_vector<T, Invoker> tmp_buffer;
+    if(!buffer)
+    {
+        tmp_buffer.resize(n);
+        buffer = tmp_buffer.data();
+    }
+
+    _natural_merge(src, buffer, bounds.data(), powers.data(), 0, k, !into_src, cmp);
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::_natural_merge(T* src, T* buffer, const size_t* bounds,
+                                                                    const size_t* powers, size_t i, size_t j,
+                                                                    bool into_buffer, Comparator cmp, Invoker invoker)
+{
+    //runs [i, j) are sorted in src and end up merged in src or buffer
+    if(j - i == 1)
+    {
+        SAL_PERF_SCOPE(phase, perf::phase::copy());
+        if(into_buffer)
+            std::copy(src + bounds[i], src + bounds[j], buffer + bounds[i]);
+
+        return;
+    }
+
+    //the boundary of lowest power is the root of the powersort merge tree over these runs
+    size_t m = i;
+    for(size_t r = i + 1; r + 1 < j; ++r)
+        if(powers[r] < powers[m])
+            m = r;
+
+    //the merge tree is unbalanced, only the size limit of a cutoff_invoker applies
+    Invoker task_invoker = utils::subproblem(invoker, bounds[j] - bounds[i], 0);
+    task_invoker(
+            [&]{_natural_merge(src, buffer, bounds, powers, i, m + 1, !into_buffer, cmp, task_invoker);},
+            [&]{_natural_merge(src, buffer, bounds, powers, m + 1, j, !into_buffer, cmp, task_invoker);}
+    );
+
+    const size_t l = bounds[i];
+    const size_t mid = bounds[m + 1];
+    const size_t r = bounds[j] - 1;
+
+    SAL_PERF_SCOPE(phase, perf::phase::merge(perf::merge_level(r - l + 1, _leaf_size())));
+    if(into_buffer)
+        merger_type::merge(src, l, mid - 1, mid, r, buffer, l, cmp, task_invoker);
+    else
+        merger_type::merge(buffer, l, mid - 1, mid, r, src, l, cmp, task_invoker);
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename BlockSorter, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::_merge_sort_common(T* src, size_t l, size_t r, T* dest, bool src2dest, Comparator cmp,
+                                                                        BlockSorter block_sorter, Invoker invoker, unsigned depth)
+{
+
+    if(r == l)
+    {
+        if(src2dest)
+            dest[l] = src[l];
+
+        return;
+    }
+
+    if((r-l) <= _leaf_size() && !src2dest)
+    {
+        SAL_PERF_SCOPE(phase, perf::phase::leaf_sort());
+        const auto started = stats_type::start();
+        block_sorter(src+l, src+r+1, cmp);
+        stats_type::leaf(r - l + 1, depth, started);
+        return;
+    }
+
+    size_t m = (r + l) / 2;
+
+    //the halves and their merge share the task cutoff of this subproblem
+    Invoker task_invoker = utils::subproblem(invoker, r - l + 1, depth);
+    stats_type::spawn(depth, utils::is_serial(task_invoker) ? 0 : 2);
+    task_invoker(
+            [&]{_merge_sort_common(src, l, m, dest, !src2dest, cmp, block_sorter, task_invoker, depth + 1);},
+            [&]{_merge_sort_common(src, m +1, r, dest, !src2dest, cmp, block_sorter, task_invoker, depth + 1);}
+    );
+
+    SAL_PERF_SCOPE(phase, perf::phase::merge(perf::merge_level(r - l + 1, _leaf_size())));
+    const auto started = stats_type::start();
+    if(src2dest)
+        merger_type::merge(src, l, m, m+1, r, dest, l, cmp, task_invoker);
+    else
+        merger_type::merge(dest, l, m, m+1, r, src, l, cmp, task_invoker);
+    stats_type::merge(depth, r - l + 1, (r - l + 1) * sizeof(T), started);
+
+
+}
+
+template<typename T, typename Invoker, size_t block_size, typename MergerSettings, typename LeafSorter>
+template<typename V, typename BlockSorter, typename Comparator>
+void sorter<T, Invoker, block_size, MergerSettings, LeafSorter>::_merge_sort_common_by_key(T* src, V* src_values, size_t l, size_t r,
+                                                                               T* dest, V* dest_values,
+                                                                               bool src2dest, Comparator cmp,
+                                                                               BlockSorter block_sorter, Invoker invoker,
+                                                                               unsigned depth)
+{
+
+    if(r == l)
+    {
+        if(src2dest) {
+            dest[l] = src[l];
+            dest_values[l] = src_values[l];
+        }
+
+        return;
+    }
+
+    if((r-l) <= _leaf_size() && !src2dest)
+    {
+        SAL_PERF_SCOPE(phase, perf::phase::leaf_sort());
+        const auto started = stats_type::start();
+        block_sorter(src+l, src+r+1, src_values+l, cmp);
+        stats_type::leaf(r - l + 1, depth, started);
+        return;
+    }
+
+    size_t m = (r + l) / 2;
+
+    Invoker task_invoker = utils::subproblem(invoker, r - l + 1, depth);
+    stats_type::spawn(depth, utils::is_serial(task_invoker) ? 0 : 2);
+    task_invoker(
+            [&]{_merge_sort_common_by_key(src, src_values, l, m, dest, dest_values, !src2dest, cmp, block_sorter, task_invoker, depth + 1);},
+            [&]{_merge_sort_common_by_key(src, src_values, m +1, r, dest, dest_values, !src2dest, cmp, block_sorter, task_invoker, depth + 1);}
+    );
+
+    SAL_PERF_SCOPE(phase, perf::phase::merge(perf::merge_level(r - l + 1, _leaf_size())));
+    const auto started = stats_type::start();
+    if(src2dest)
+        merger_type::merge_by_key(src, src_values, l, m, m+1, r, dest, dest_values, l, cmp, task_invoker);
+    else
+        merger_type::merge_by_key(dest, dest_values, l, m, m+1, r, src, src_values, l, cmp, task_invoker);
+    stats_type::merge(depth, r - l + 1, (r - l + 1) * (sizeof(T) + sizeof(V)), started);
+
+
+}
+
+/**
+ * Parallel LSD radix sort of integer, float and double keys in ascending order, stable.
+ * Each pass counts digits per chunk on the tasks of the invoker, one chunk per thread, and
+ * scatters through write-combining buffers; passes over a digit shared by all keys are skipped.
+ */
+template<typename T, typename Invoker = parallel_invoker>
+class radix_sorter {
+public:
+    static_assert(internal::radix_key<T>::value, "radix_sorter requires integer, float or double keys");
+
+    radix_sorter() = delete;
+
+    template<typename Iterator>
+    static void radix_sort(Iterator first, Iterator last);
+
+    // The input range is used as scratch
+    template<typename Iterator>
+    static void radix_sort(Iterator first, Iterator last, Iterator out);
+
+    template<typename Iterator>
+    static void radix_sort(Iterator first, Iterator last, sort_workspace& workspace);
+};
+
+template<typename T, typename Invoker>
+template<typename Iterator>
+void radix_sorter<T, Invoker>::radix_sort(Iterator first, Iterator last)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 2)
+        return;
+
+    internal::scratch_vector<T, Invoker> tmp_buffer;
+    tmp_buffer.resize(n);
+
+    auto src = utils::iterator2pointer(first);
+
+    T* res = internal::parallel_radix_sort(src, tmp_buffer.data(), n, Invoker());
+    if(res != src)
+    {
+        SAL_PERF_SCOPE(phase, perf::phase::copy());
+        std::copy(res, res + n, src);
+    }
+}
+
+template<typename T, typename Invoker>
+template<typename Iterator>
+void radix_sorter<T, Invoker>::radix_sort(Iterator first, Iterator last, Iterator out)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 1)
+        return;
+
+    auto src = utils::iterator2pointer(first);
+    auto outp = utils::iterator2pointer(out);
+
+    T* res = internal::parallel_radix_sort(src, outp, n, Invoker());
+    if(res != outp)
+    {
+        SAL_PERF_SCOPE(phase, perf::phase::copy());
+        std::copy(res, res + n, outp);
+    }
+}
+
+template<typename T, typename Invoker>
+template<typename Iterator>
+void radix_sorter<T, Invoker>::radix_sort(Iterator first, Iterator last, sort_workspace& workspace)
+{
+    static_assert(std::is_same<T, typename std::iterator_traits<Iterator>::value_type>::value,
+                  "Specified type must be the same as type of iterators");
+    static_assert(is_random_access_iterator<Iterator>::value,
+                  "Iterators must be of random-access iterator type");
+
+    long long n = std::distance(first, last);
+    if(n < 2)
+        return;
+
+    auto src = utils::iterator2pointer(first);
+
+    T* res = internal::parallel_radix_sort(src, workspace.scratch<T>(n, Invoker()), n, Invoker());
+    if(res != src)
+    {
+        SAL_PERF_SCOPE(phase, perf::phase::copy());
+        std::copy(res, res + n, src);
+    }
+}
+
+}}
+
+#include "sort.cpp"
 
 #endif //SAL_SORT_HPP
@@ -0,0 +1,210 @@
+//
+// Sorted multiset of keys taking batched inserts, kept as a few sorted levels merged by size ratio.
+//
+
+#ifndef SAL_SORTED_VECTOR_HPP
+#define SAL_SORTED_VECTOR_HPP
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include "sort.hpp"
+
+namespace sal { namespace sort {
+
+namespace internal {
+
+// Allocator of the levels, placed by the threads of Invoker; sizing a level leaves trivial keys
+// uninitialized since a merge or copy writes them all
+template<typename T, typename Invoker>
+class level_allocator : public aligned_allocator<T, sizeof(T), numa::first_touch_placement<Invoker>, pages::transparent_huge_pages<>> {
+    using base = aligned_allocator<T, sizeof(T), numa::first_touch_placement<Invoker>, pages::transparent_huge_pages<>>;
+
+public:
+    template<typename U>
+    struct rebind {
+        typedef level_allocator<U, Invoker> other;
+    };
+
+    level_allocator() { }
+
+    template<typename U>
+    level_allocator(const level_allocator<U, Invoker>&) { }
+
+    using base::construct;
+
+    template<typename U>
+    void construct(U* p) const { ::new (static_cast<void*>(p)) U; }
+};
+
+}
+
+/**
+ * Sorted keys in levels, largest first, each at least Ratio times the size of the next one. A
+ * batch is sorted by Sorter on its own and pushed as the newest level; levels that break the
+ * ratio are merged with the merger of Sorter, so a key takes part in about log_Ratio(n / batch)
+ * merges over its lifetime instead of a full sort per batch. Single keys wait in a small buffer
+ * that goes in as a batch when full. Lookups search every level and the buffer. Equal keys are
+ * all kept, in ascending order of operator<; float and double NaNs come after all numbers and are
+ * equal to each other. Not thread safe.
+ */
+template<typename T, typename Sorter = sorter<T>, size_t Ratio = 4>
+class sorted_vector {
+    static_assert(Ratio >= 2, "levels must grow by at least a factor of two");
+
+public:
+    using level_type = std::vector<T, internal::level_allocator<T, typename Sorter::invoker_type>>;
+    using merger_type = typename Sorter::merger_type;
+
+    static constexpr size_t default_buffer_capacity = 4096;
+
+    explicit sorted_vector(size_t buffer_capacity = default_buffer_capacity)
+            : buffer_capacity_(std::max<size_t>(1, buffer_capacity)), size_(0) { }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    size_t level_count() const { return levels_.size(); }
+
+    const std::vector<level_type>& levels() const { return levels_; }
+
+    void insert(const T& key)
+    {
+        buffer_.push_back(key);
+        ++size_;
+        if (buffer_.size() >= buffer_capacity_)
+            flush();
+    }
+
+    // Sorts the keys, together with the buffered ones, as one new level
+    template<typename Iterator>
+    void insert(Iterator first, Iterator last)
+    {
+        const size_t n = std::distance(first, last);
+        if (n == 0)
+            return;
+
+        level_type batch(n + buffer_.size());
+        std::copy(first, last, batch.begin());
+        std::copy(buffer_.begin(), buffer_.end(), batch.begin() + n);
+        size_ += n;
+        buffer_.clear();
+
+        _push(std::move(batch));
+    }
+
+    // Moves the buffered keys into the levels
+    void flush()
+    {
+        if (buffer_.empty())
+            return;
+
+        level_type batch(buffer_.begin(), buffer_.end());
+        buffer_.clear();
+        _push(std::move(batch));
+    }
+
+    bool contains(const T& key) const
+    {
+        const order_type order = _order();
+        for (auto& level : levels_) {
+            if (std::binary_search(level.begin(), level.end(), key, order))
+                return true;
+        }
+
+        for (auto& x : buffer_) {
+            if (!order(x, key) && !order(key, x))
+                return true;
+        }
+
+        return false;
+    }
+
+    size_t count(const T& key) const
+    {
+        const order_type order = _order();
+        size_t result = 0;
+        for (auto& level : levels_) {
+            auto range = std::equal_range(level.begin(), level.end(), key, order);
+            result += range.second - range.first;
+        }
+
+        for (auto& x : buffer_)
+            result += !order(x, key) && !order(key, x);
+
+        return result;
+    }
+
+    // Number of keys ordered before key, the position key would take in the merged order
+    size_t rank(const T& key) const
+    {
+        const order_type order = _order();
+        size_t result = 0;
+        for (auto& level : levels_)
+            result += std::lower_bound(level.begin(), level.end(), key, order) - level.begin();
+
+        for (auto& x : buffer_)
+            result += order(x, key);
+
+        return result;
+    }
+
+    // Merges everything into a single level and returns it
+    const level_type& compact()
+    {
+        flush();
+        while (levels_.size() > 1)
+            _merge_top();
+
+        if (levels_.empty())
+            levels_.emplace_back();
+
+        return levels_.front();
+    }
+
+    void clear()
+    {
+        levels_.clear();
+        buffer_.clear();
+        size_ = 0;
+    }
+
+private:
+    //order of the levels: operator<, with float and double NaNs after all numbers as the sorter puts them
+    using order_type = decltype(merge::internal::scalar_order(std::less<T>()));
+
+    static order_type _order() { return merge::internal::scalar_order(std::less<T>()); }
+
+    void _push(level_type batch)
+    {
+        Sorter::merge_sort(batch.begin(), batch.end());
+        levels_.push_back(std::move(batch));
+
+        //a level must be Ratio times its successor, the newest level merges down as far as it breaks that
+        while (levels_.size() > 1 && levels_[levels_.size() - 2].size() < Ratio * levels_.back().size())
+            _merge_top();
+    }
+
+    void _merge_top()
+    {
+        level_type& lower = levels_[levels_.size() - 2];
+        level_type& upper = levels_.back();
+
+        level_type merged(lower.size() + upper.size());
+        merger_type::merge(lower.begin(), lower.end(), upper.begin(), upper.end(), merged.begin());
+
+        levels_.pop_back();
+        levels_.back() = std::move(merged);
+    }
+
+    size_t buffer_capacity_;
+    size_t size_;
+    std::vector<level_type> levels_;
+    std::vector<T> buffer_;
+};
+
+}}
+
+#endif //SAL_SORTED_VECTOR_HPP
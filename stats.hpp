@@ -0,0 +1,389 @@
+//
+// Work and task statistics of the divide-and-conquer sort and merge, selected as a policy.
+//
+
+#ifndef SAL_STATS_HPP
+#define SAL_STATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#ifndef SAL_NO_TBB
+#include <tbb/enumerable_thread_specific.h>
+#endif
+
+namespace sal { namespace stats {
+
+constexpr std::size_t histogram_buckets = 48;
+constexpr std::size_t max_levels = 64;
+
+// Sizes by power of two: bucket b counts sizes in [2^b, 2^(b+1)), bucket 0 also counts 0
+struct histogram {
+    std::array<std::uint64_t, histogram_buckets> counts;
+
+    histogram() : counts() { }
+
+    static std::size_t bucket(std::size_t n)
+    {
+        std::size_t b = 0;
+        while (n > 1 && b + 1 < histogram_buckets) {
+            n >>= 1;
+            ++b;
+        }
+        return b;
+    }
+
+    void add(std::size_t n) { ++counts[bucket(n)]; }
+
+    std::uint64_t total() const
+    {
+        std::uint64_t sum = 0;
+        for (auto count : counts)
+            sum += count;
+        return sum;
+    }
+
+    histogram& operator+=(const histogram& other)
+    {
+        for (std::size_t b = 0; b < histogram_buckets; ++b)
+            counts[b] += other.counts[b];
+        return *this;
+    }
+};
+
+// Merges of one sort recursion depth, depth 0 is the final merge
+struct level_stats {
+    std::uint64_t merges;
+    std::uint64_t bytes_read;
+    std::uint64_t bytes_written;
+    std::uint64_t nanoseconds;
+};
+
+struct work_stats {
+    std::uint64_t tasks;                // handed to a parallel invoker or parallel_for
+    unsigned max_sort_depth;
+    unsigned max_merge_depth;
+    histogram leaf_sizes;               // keys per BlockSorter call
+    histogram merge_block_sizes;        // keys per BlockMerger call
+    std::vector<level_stats> levels;
+    std::uint64_t search_probes;        // comparisons of the split searches
+    std::uint64_t block_sorter_ns;
+    std::uint64_t block_merger_ns;
+
+    work_stats() : tasks(0), max_sort_depth(0), max_merge_depth(0), search_probes(0), block_sorter_ns(0), block_merger_ns(0) { }
+
+    work_stats& operator+=(const work_stats& other)
+    {
+        tasks += other.tasks;
+        max_sort_depth = std::max(max_sort_depth, other.max_sort_depth);
+        max_merge_depth = std::max(max_merge_depth, other.max_merge_depth);
+        leaf_sizes += other.leaf_sizes;
+        merge_block_sizes += other.merge_block_sizes;
+        if (levels.size() < other.levels.size())
+            levels.resize(other.levels.size(), level_stats());
+        for (std::size_t i = 0; i < other.levels.size(); ++i) {
+            levels[i].merges += other.levels[i].merges;
+            levels[i].bytes_read += other.levels[i].bytes_read;
+            levels[i].bytes_written += other.levels[i].bytes_written;
+            levels[i].nanoseconds += other.levels[i].nanoseconds;
+        }
+        search_probes += other.search_probes;
+        block_sorter_ns += other.block_sorter_ns;
+        block_merger_ns += other.block_merger_ns;
+        return *this;
+    }
+};
+
+namespace internal {
+
+inline std::uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Comparisons of a binary search over n keys
+inline std::uint64_t probes(std::size_t n)
+{
+    std::uint64_t count = 0;
+    for (; n; n >>= 1)
+        ++count;
+    return count;
+}
+
+inline void update_max(std::atomic<unsigned>& target, unsigned value)
+{
+    unsigned current = target.load(std::memory_order_relaxed);
+    while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+}
+
+}
+
+// Accumulation modes of recorder
+struct per_thread {};       // every thread adds to its own work_stats, combined by snapshot()
+struct shared_atomic {};    // all threads add to one set of relaxed atomic counters
+
+// per_thread keeps its work_stats in TBB thread-local storage, built with SAL_NO_TBB only shared_atomic exists
+#ifdef SAL_NO_TBB
+using default_accumulation = shared_atomic;
+#else
+using default_accumulation = per_thread;
+#endif
+
+/**
+ * The stats object: collects what the sorters and mergers report while attached to a collect
+ * policy, see attach. snapshot() may run while recording in shared_atomic mode only.
+ */
+template<typename Accumulation = default_accumulation>
+class recorder;
+
+#ifndef SAL_NO_TBB
+template<>
+class recorder<per_thread> {
+public:
+    void spawn(unsigned depth, std::size_t tasks)
+    {
+        work_stats& s = local_.local();
+        s.tasks += tasks;
+        s.max_sort_depth = std::max(s.max_sort_depth, depth + 1);
+    }
+
+    void merge_spawn(unsigned depth, std::size_t tasks)
+    {
+        work_stats& s = local_.local();
+        s.tasks += tasks;
+        s.max_merge_depth = std::max(s.max_merge_depth, depth + 1);
+    }
+
+    void leaf(std::size_t n, unsigned depth, std::uint64_t ns)
+    {
+        work_stats& s = local_.local();
+        s.leaf_sizes.add(n);
+        s.block_sorter_ns += ns;
+        s.max_sort_depth = std::max(s.max_sort_depth, depth);
+    }
+
+    void merge(unsigned depth, std::size_t bytes, std::uint64_t ns)
+    {
+        work_stats& s = local_.local();
+        if (s.levels.size() <= depth)
+            s.levels.resize(depth + 1, level_stats());
+        ++s.levels[depth].merges;
+        s.levels[depth].bytes_read += bytes;
+        s.levels[depth].bytes_written += bytes;
+        s.levels[depth].nanoseconds += ns;
+    }
+
+    void block_merge(std::size_t n, std::uint64_t ns)
+    {
+        work_stats& s = local_.local();
+        s.merge_block_sizes.add(n);
+        s.block_merger_ns += ns;
+    }
+
+    void search(std::size_t n, std::size_t searches) { local_.local().search_probes += searches * internal::probes(n); }
+
+    work_stats snapshot() const
+    {
+        work_stats total;
+        for (auto& s : local_)
+            total += s;
+        return total;
+    }
+
+    void reset() { local_.clear(); }
+
+private:
+    tbb::enumerable_thread_specific<work_stats> local_;
+};
+#endif
+
+template<>
+class recorder<shared_atomic> {
+public:
+    recorder() { reset(); }
+
+    void spawn(unsigned depth, std::size_t tasks)
+    {
+        tasks_.fetch_add(tasks, std::memory_order_relaxed);
+        internal::update_max(max_sort_depth_, depth + 1);
+    }
+
+    void merge_spawn(unsigned depth, std::size_t tasks)
+    {
+        tasks_.fetch_add(tasks, std::memory_order_relaxed);
+        internal::update_max(max_merge_depth_, depth + 1);
+    }
+
+    void leaf(std::size_t n, unsigned depth, std::uint64_t ns)
+    {
+        leaf_sizes_[histogram::bucket(n)].fetch_add(1, std::memory_order_relaxed);
+        block_sorter_ns_.fetch_add(ns, std::memory_order_relaxed);
+        internal::update_max(max_sort_depth_, depth);
+    }
+
+    void merge(unsigned depth, std::size_t bytes, std::uint64_t ns)
+    {
+        const std::size_t d = std::min<std::size_t>(depth, max_levels - 1);
+        levels_[d][0].fetch_add(1, std::memory_order_relaxed);
+        levels_[d][1].fetch_add(bytes, std::memory_order_relaxed);
+        levels_[d][2].fetch_add(bytes, std::memory_order_relaxed);
+        levels_[d][3].fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void block_merge(std::size_t n, std::uint64_t ns)
+    {
+        merge_block_sizes_[histogram::bucket(n)].fetch_add(1, std::memory_order_relaxed);
+        block_merger_ns_.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void search(std::size_t n, std::size_t searches)
+    {
+        search_probes_.fetch_add(searches * internal::probes(n), std::memory_order_relaxed);
+    }
+
+    work_stats snapshot() const
+    {
+        work_stats s;
+        s.tasks = tasks_.load(std::memory_order_relaxed);
+        s.max_sort_depth = max_sort_depth_.load(std::memory_order_relaxed);
+        s.max_merge_depth = max_merge_depth_.load(std::memory_order_relaxed);
+        for (std::size_t b = 0; b < histogram_buckets; ++b) {
+            s.leaf_sizes.counts[b] = leaf_sizes_[b].load(std::memory_order_relaxed);
+            s.merge_block_sizes.counts[b] = merge_block_sizes_[b].load(std::memory_order_relaxed);
+        }
+        for (std::size_t d = 0; d < max_levels && levels_[d][0].load(std::memory_order_relaxed); ++d) {
+            s.levels.push_back({ levels_[d][0].load(std::memory_order_relaxed), levels_[d][1].load(std::memory_order_relaxed),
+                                 levels_[d][2].load(std::memory_order_relaxed), levels_[d][3].load(std::memory_order_relaxed) });
+        }
+        s.search_probes = search_probes_.load(std::memory_order_relaxed);
+        s.block_sorter_ns = block_sorter_ns_.load(std::memory_order_relaxed);
+        s.block_merger_ns = block_merger_ns_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void reset()
+    {
+        tasks_ = 0;
+        max_sort_depth_ = 0;
+        max_merge_depth_ = 0;
+        for (std::size_t b = 0; b < histogram_buckets; ++b) {
+            leaf_sizes_[b] = 0;
+            merge_block_sizes_[b] = 0;
+        }
+        for (auto& level : levels_) {
+            for (auto& value : level)
+                value = 0;
+        }
+        search_probes_ = 0;
+        block_sorter_ns_ = 0;
+        block_merger_ns_ = 0;
+    }
+
+private:
+    std::atomic<std::uint64_t> tasks_;
+    std::atomic<unsigned> max_sort_depth_;
+    std::atomic<unsigned> max_merge_depth_;
+    std::atomic<std::uint64_t> leaf_sizes_[histogram_buckets];
+    std::atomic<std::uint64_t> merge_block_sizes_[histogram_buckets];
+    std::atomic<std::uint64_t> levels_[max_levels][4];
+    std::atomic<std::uint64_t> search_probes_;
+    std::atomic<std::uint64_t> block_sorter_ns_;
+    std::atomic<std::uint64_t> block_merger_ns_;
+};
+
+/**
+ * Stats policies of merger and merger_settings. no_stats is the default, its hooks are empty and
+ * compile away. collect forwards to the recorder attached to it; Tag tells apart collections that
+ * run concurrently.
+ */
+struct no_stats {
+    static std::uint64_t start() { return 0; }
+    static void spawn(unsigned, std::size_t) { }
+    static void merge_spawn(unsigned, std::size_t) { }
+    static void leaf(std::size_t, unsigned, std::uint64_t) { }
+    static void merge(unsigned, std::size_t, std::size_t, std::uint64_t) { }
+    static void block_merge(std::size_t, std::uint64_t) { }
+    static void search(std::size_t, std::size_t = 1) { }
+};
+
+template<typename Accumulation = default_accumulation, typename Tag = void>
+struct collect {
+    using recorder_type = recorder<Accumulation>;
+
+    // Atomic, so attaching on one thread while another thread sorts is not a data race
+    static std::atomic<recorder_type*>& current()
+    {
+        static std::atomic<recorder_type*> r(nullptr);
+        return r;
+    }
+
+    static recorder_type* attached() { return current().load(std::memory_order_acquire); }
+
+    static std::uint64_t start() { return attached() ? internal::now_ns() : 0; }
+
+    static void spawn(unsigned depth, std::size_t tasks)
+    {
+        if (recorder_type* r = attached())
+            r->spawn(depth, tasks);
+    }
+
+    static void merge_spawn(unsigned depth, std::size_t tasks)
+    {
+        if (recorder_type* r = attached())
+            r->merge_spawn(depth, tasks);
+    }
+
+    static void leaf(std::size_t n, unsigned depth, std::uint64_t started)
+    {
+        if (recorder_type* r = attached())
+            r->leaf(n, depth, internal::now_ns() - started);
+    }
+
+    // A merge of n keys, bytes of keys and payloads, that began at started
+    static void merge(unsigned depth, std::size_t, std::size_t bytes, std::uint64_t started)
+    {
+        if (recorder_type* r = attached())
+            r->merge(depth, bytes, internal::now_ns() - started);
+    }
+
+    static void block_merge(std::size_t n, std::uint64_t started)
+    {
+        if (recorder_type* r = attached())
+            r->block_merge(n, internal::now_ns() - started);
+    }
+
+    // searches binary searches over n keys each
+    static void search(std::size_t n, std::size_t searches = 1)
+    {
+        if (recorder_type* r = attached())
+            r->search(n, searches);
+    }
+};
+
+/**
+ * Routes the reports of the Stats policy to a recorder while in scope, attach before the sort
+ * starts. Sorts already running switch to r at their next report; scopes of one Tag on several
+ * threads must still nest, the last one to end restores the recorder it replaced.
+ */
+template<typename Stats>
+class attach {
+public:
+    explicit attach(typename Stats::recorder_type& r)
+            : previous_(Stats::current().exchange(&r, std::memory_order_acq_rel)) { }
+
+    ~attach() { Stats::current().store(previous_, std::memory_order_release); }
+
+    attach(const attach&) = delete;
+    attach& operator=(const attach&) = delete;
+
+private:
+    typename Stats::recorder_type* previous_;
+};
+
+}}
+
+#endif //SAL_STATS_HPP
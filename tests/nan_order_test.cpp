@@ -0,0 +1,197 @@
+//
+// Every sort and merge entry point orders float and double NaNs after all numbers under std::less.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+#include "sort.hpp"
+#include "external.hpp"
+#include "sorted_vector.hpp"
+
+using namespace sal;
+using namespace sal::merge;
+
+static int failures = 0;
+
+template<typename T>
+bool nan_last(const std::vector<T>& a)
+{
+    size_t numbers = 0;
+    while (numbers < a.size() && a[numbers] == a[numbers])
+        ++numbers;
+
+    for (size_t i = numbers; i < a.size(); ++i) {
+        if (a[i] == a[i])
+            return false;
+    }
+
+    return std::is_sorted(a.begin(), a.begin() + numbers);
+}
+
+template<typename T>
+std::vector<T> make_input(size_t n)
+{
+    std::mt19937_64 rng(n);
+    std::vector<T> a(n);
+    for (auto& x : a)
+        x = rng() % 8 == 0 ? std::numeric_limits<T>::quiet_NaN() : T(int64_t(rng() % 2000000) - 1000000) / T(7);
+
+    return a;
+}
+
+template<typename T>
+void check(const char* name, size_t n, const std::function<void(std::vector<T>&)>& sort)
+{
+    std::vector<T> a = make_input<T>(n);
+    sort(a);
+    if (!nan_last(a)) {
+        std::cout << "FAIL " << name << " " << (sizeof(T) == 4 ? "float" : "double") << " n=" << n << std::endl;
+        ++failures;
+    }
+}
+
+template<typename T>
+void check_all(size_t n)
+{
+    using S = sort::sorter<T>;
+    using serial = sort::sorter<T, utils::serial_invoker>;
+    using path = sort::sorter<T, utils::parallel_invoker, 8192, merger_settings<auto_merger, merge_path_partition<>>>;
+
+    check<T>("merge_sort", n, [](std::vector<T>& a) { S::merge_sort(a.begin(), a.end()); });
+    check<T>("serial merge_sort", n, [](std::vector<T>& a) { serial::merge_sort(a.begin(), a.end()); });
+    check<T>("merge path merge_sort", n, [](std::vector<T>& a) { path::merge_sort(a.begin(), a.end()); });
+    check<T>("stable_merge_sort", n, [](std::vector<T>& a) { S::stable_merge_sort(a.begin(), a.end()); });
+    check<T>("sample_sort", n, [](std::vector<T>& a) { S::sample_sort(a.begin(), a.end()); });
+    check<T>("multiway_merge_sort", n, [](std::vector<T>& a) { S::multiway_merge_sort(a.begin(), a.end()); });
+    check<T>("natural_merge_sort", n, [](std::vector<T>& a) { S::natural_merge_sort(a.begin(), a.end()); });
+    check<T>("radix_sort", n, [](std::vector<T>& a) { sort::radix_sorter<T>::radix_sort(a.begin(), a.end()); });
+    check<T>("serial radix_sort", n, [](std::vector<T>& a) {
+        sort::radix_sorter<T, utils::serial_invoker>::radix_sort(a.begin(), a.end());
+    });
+    check<T>("radix leaf merge_sort", n, [](std::vector<T>& a) { sort::radix_leaf_sorter<T>::merge_sort(a.begin(), a.end()); });
+    check<T>("radix leaf sample_sort", n, [](std::vector<T>& a) { sort::radix_leaf_sorter<T>::sample_sort(a.begin(), a.end()); });
+    check<T>("merge_sort_by_key", n, [](std::vector<T>& a) {
+        std::vector<int> values(a.size());
+        S::merge_sort_by_key(a.begin(), a.end(), values.begin());
+    });
+
+    //merges of two and of many sorted runs
+    check<T>("merger::merge", n, [](std::vector<T>& a) {
+        const size_t mid = a.size() / 2;
+        sort::sorter<T>::merge_sort(a.begin(), a.begin() + mid);
+        sort::sorter<T>::merge_sort(a.begin() + mid, a.end());
+
+        std::vector<T> out(a.size());
+        merger<T, parallel_invoker, default_merger>::merge(a.begin(), a.begin() + mid, a.begin() + mid, a.end(), out.begin());
+        a.swap(out);
+    });
+    check<T>("kway_merger::merge", n, [](std::vector<T>& a) {
+        std::vector<std::pair<typename std::vector<T>::iterator, typename std::vector<T>::iterator>> runs;
+        for (size_t i = 0; i < 5; ++i) {
+            auto first = a.begin() + a.size() * i / 5;
+            auto last = a.begin() + a.size() * (i + 1) / 5;
+            sort::sorter<T>::merge_sort(first, last);
+            runs.emplace_back(first, last);
+        }
+
+        std::vector<T> out(a.size());
+        kway_merger<T>::merge(runs, out.begin());
+        a.swap(out);
+    });
+}
+
+// Out-of-core sort of n keys with a 6 MiB budget, several runs merged block by block
+template<typename T>
+void check_external(size_t n)
+{
+    const std::string input = "nan_order_input.bin";
+    const std::string output = "nan_order_output.bin";
+
+    std::vector<T> a = make_input<T>(n);
+    {
+        std::ofstream file(input, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(a.data()), a.size() * sizeof(T));
+    }
+
+    sort::external_sorter<T>::sort(input, output, 6 << 20, ".");
+
+    std::ifstream file(output, std::ios::binary);
+    file.read(reinterpret_cast<char*>(a.data()), a.size() * sizeof(T));
+    if (!file || !nan_last(a)) {
+        std::cout << "FAIL external_sorter::sort " << (sizeof(T) == 4 ? "float" : "double") << " n=" << n << std::endl;
+        ++failures;
+    }
+
+    std::remove(input.c_str());
+    std::remove(output.c_str());
+}
+
+// Lookups of a sorted_vector in levels and in the buffer, against a count over the keys with NaNs equal to each other
+template<typename T>
+void check_sorted_vector()
+{
+    const char* type = sizeof(T) == 4 ? "float" : "double";
+    const T nan = std::numeric_limits<T>::quiet_NaN();
+
+    sort::sorted_vector<T> buffered;
+    for (int i = 0; i < 5; ++i)
+        buffered.insert(T(i));
+    buffered.insert(nan);
+    buffered.insert(nan);
+
+    if (buffered.count(T(3)) != 1 || buffered.rank(T(3)) != 3 || buffered.count(nan) != 2 || buffered.rank(nan) != 5 ||
+        !buffered.contains(nan) || buffered.contains(T(7))) {
+        std::cout << "FAIL sorted_vector buffer lookups " << type << std::endl;
+        ++failures;
+    }
+
+    std::vector<T> keys = make_input<T>(20000);
+    for (auto& x : keys)
+        x = x == x ? std::round(x / T(1000)) : x;
+
+    sort::sorted_vector<T> levels(64);
+    levels.insert(keys.begin(), keys.begin() + 15000);
+    for (size_t i = 15000; i < keys.size(); ++i)
+        levels.insert(keys[i]);
+
+    auto equal = [](T a, T b) { return a == b || (a != a && b != b); };
+    auto before = [](T a, T b) { return a < b || (a == a && b != b); };
+
+    std::vector<T> probes(keys.begin(), keys.begin() + 50);
+    probes.push_back(nan);
+    probes.push_back(T(1e9));
+    for (T key : probes) {
+        size_t count = 0, rank = 0;
+        for (T x : keys) {
+            count += equal(x, key);
+            rank += before(x, key);
+        }
+
+        if (levels.count(key) != count || levels.rank(key) != rank || levels.contains(key) != (count > 0)) {
+            std::cout << "FAIL sorted_vector level lookups " << type << " key=" << key << std::endl;
+            ++failures;
+        }
+    }
+}
+
+int main()
+{
+    for (size_t n : {100, 10000, 300000}) {
+        check_all<float>(n);
+        check_all<double>(n);
+    }
+
+    check_external<float>(3000000);
+    check_external<double>(1500000);
+    check_sorted_vector<float>();
+    check_sorted_vector<double>();
+
+    std::cout << "NaN order: " << (failures ? "failed" : "ok") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+//
+// The dispatched merge, merge by key and block sort kernels against std::merge and std::sort, for
+// every key type with kernels and the sizes around the vector widths. ctest runs it once per
+// SAL_SIMD_LEVEL tier; a tier above the host runs the highest one the host supports.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <vector>
+#include "sort.hpp"
+
+using namespace sal;
+
+static int failures = 0;
+
+static const size_t sizes[] = { 0, 1, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 4095, 4096, 4097 };
+
+template<typename T>
+const char* type_name()
+{
+    return std::is_floating_point<T>::value ? (sizeof(T) == 4 ? "float" : "double")
+                                            : std::is_signed<T>::value ? (sizeof(T) == 4 ? "int32" : "int64")
+                                                                       : (sizeof(T) == 4 ? "uint32" : "uint64");
+}
+
+template<typename T>
+void expect(bool ok, const char* what, size_t n1, size_t n2, unsigned dist)
+{
+    if (!ok) {
+        std::cout << "FAIL " << what << " " << type_name<T>() << " n1=" << n1 << " n2=" << n2
+                  << " input=" << dist << std::endl;
+        ++failures;
+    }
+}
+
+// Input 0 spans the whole type with its extremes, 1 has few distinct keys, 2 is already sorted
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value, T>::type make_key(std::mt19937_64& rng, unsigned dist, size_t i)
+{
+    switch (dist) {
+        case 0:
+            if (rng() % 64 == 0)
+                return rng() % 2 ? std::numeric_limits<T>::min() : std::numeric_limits<T>::max();
+            return T(rng());
+        case 1:
+            return T(rng() % 5) - T(2);
+        default:
+            return T(i);
+    }
+}
+
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value, T>::type make_key(std::mt19937_64& rng, unsigned dist, size_t i)
+{
+    switch (dist) {
+        case 0:
+            switch (rng() % 64) {
+                case 0: return std::numeric_limits<T>::infinity();
+                case 1: return -std::numeric_limits<T>::infinity();
+                case 2: return -T(0);
+                case 3: return std::numeric_limits<T>::denorm_min();
+                case 4: return std::numeric_limits<T>::lowest();
+                default: return T(int64_t(rng() % 2000001) - 1000000) / T(3);
+            }
+        case 1:
+            return T(int(rng() % 5) - 2);
+        default:
+            return T(i);
+    }
+}
+
+template<typename T>
+std::vector<T> make_input(size_t n, unsigned dist, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<T> a(n);
+    for (size_t i = 0; i < n; ++i)
+        a[i] = make_key<T>(rng, dist, i);
+
+    return a;
+}
+
+// Inputs start one element past an aligned vector when offset is set, so the kernels see unaligned heads
+template<typename T>
+void check_merge(size_t n1, size_t n2, unsigned dist, size_t offset)
+{
+    std::vector<T> a = make_input<T>(n1 + offset, dist, n1 * 31 + n2);
+    std::vector<T> b = make_input<T>(n2 + offset, dist, n2 * 17 + n1 + 1);
+    std::sort(a.begin() + offset, a.end());
+    std::sort(b.begin() + offset, b.end());
+
+    std::vector<T> expected(n1 + n2);
+    std::merge(a.begin() + offset, a.end(), b.begin() + offset, b.end(), expected.begin());
+
+    std::vector<T> out(n1 + n2 + offset);
+    merge::internal::sequential_simd_merge(a.data() + offset, a.data() + a.size(), b.data() + offset,
+                                           b.data() + b.size(), out.data() + offset);
+    expect<T>(std::equal(expected.begin(), expected.end(), out.begin() + offset), "sequential_simd_merge", n1, n2, dist);
+}
+
+// Values are the positions of the keys in the concatenated inputs, every one must come out once next to its key
+template<typename T>
+void check_merge_by_key(size_t n1, size_t n2, unsigned dist)
+{
+    using V = typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type;
+
+    std::vector<T> keys = make_input<T>(n1 + n2, dist, n1 * 13 + n2 + 2);
+    std::sort(keys.begin(), keys.begin() + n1);
+    std::sort(keys.begin() + n1, keys.end());
+
+    std::vector<V> values(n1 + n2);
+    for (size_t i = 0; i < values.size(); ++i)
+        values[i] = V(i);
+
+    std::vector<T> expected(n1 + n2);
+    std::merge(keys.begin(), keys.begin() + n1, keys.begin() + n1, keys.end(), expected.begin());
+
+    std::vector<T> out(n1 + n2);
+    std::vector<V> out_values(n1 + n2);
+    const T* k = keys.data();
+    merge::simd_merger()(k, k + n1, values.data(), k + n1, k + n1 + n2, values.data() + n1,
+                         out.data(), out_values.data(), std::less<T>());
+
+    bool ok = std::equal(expected.begin(), expected.end(), out.begin());
+    std::vector<bool> seen(n1 + n2, false);
+    for (size_t i = 0; ok && i < out_values.size(); ++i) {
+        const V v = out_values[i];
+        ok = v < seen.size() && !seen[v] && keys[v] == out[i];
+        if (ok)
+            seen[v] = true;
+    }
+    expect<T>(ok, "simd_merger::merge_by_key", n1, n2, dist);
+}
+
+template<typename T>
+void check_block_sort(size_t n, unsigned dist)
+{
+    std::vector<T> a = make_input<T>(n, dist, n * 7 + 3);
+    if (dist == 2)
+        std::reverse(a.begin(), a.end());
+
+    std::vector<T> expected = a;
+    std::sort(expected.begin(), expected.end());
+
+    sort::internal::simd_block_sorter()(a.begin(), a.end(), std::less<T>());
+    expect<T>(std::equal(expected.begin(), expected.end(), a.begin()), "simd_block_sorter", n, 0, dist);
+}
+
+template<typename T>
+void check_type()
+{
+    for (unsigned dist = 0; dist < 3; ++dist) {
+        for (size_t n1 : sizes) {
+            for (size_t n2 : sizes) {
+                check_merge<T>(n1, n2, dist, 0);
+                check_merge<T>(n1, n2, dist, 1);
+                check_merge_by_key<T>(n1, n2, dist);
+            }
+
+            check_block_sort<T>(n1, dist);
+        }
+    }
+}
+
+int main()
+{
+    std::cout << "SIMD tier: " << dispatch::simd_level_name(dispatch::active_simd_level()) << std::endl;
+
+    check_type<int32_t>();
+    check_type<uint32_t>();
+    check_type<int64_t>();
+    check_type<uint64_t>();
+    check_type<float>();
+    check_type<double>();
+
+    std::cout << "SIMD kernels: " << (failures ? "failed" : "ok") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,350 @@
+//
+// Chase-Lev deque, fork/join and exceptions of the work-stealing pool, and sorts on it staying off TBB.
+//
+
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "sort.hpp"
+#include "thread_pool.hpp"
+
+using namespace sal;
+using utils::internal::pool_task;
+using utils::internal::task_deque;
+
+static int failures = 0;
+
+static void expect(bool ok, const char* what)
+{
+    if (!ok) {
+        std::cout << "FAIL " << what << std::endl;
+        ++failures;
+    }
+}
+
+static void nop(pool_task*) { }
+
+struct counted_task : pool_task {
+    size_t index;
+
+    explicit counted_task(size_t i) : pool_task(&nop), index(i) { }
+};
+
+void test_deque()
+{
+    std::deque<counted_task> tasks;
+    for (std::int64_t i = 0; i <= task_deque::capacity; ++i)
+        tasks.emplace_back(i);
+
+    std::unique_ptr<task_deque> deque(new task_deque());
+
+    expect(deque->pop() == nullptr && deque->steal() == nullptr, "empty deque gives nothing");
+
+    //owner end is last in first out, thieves take the oldest
+    for (int i = 0; i < 3; ++i)
+        deque->push(&tasks[i]);
+    expect(deque->pop() == &tasks[2], "pop takes the newest");
+    expect(deque->steal() == &tasks[0], "steal takes the oldest");
+    expect(deque->pop() == &tasks[1], "pop takes the last one");
+    expect(deque->pop() == nullptr, "drained deque gives nothing");
+
+    for (std::int64_t i = 0; i < task_deque::capacity; ++i)
+        expect(deque->push(&tasks[i]), "push below capacity");
+    expect(!deque->push(&tasks[task_deque::capacity]), "push into a full deque fails");
+    expect(deque->steal() == &tasks[0], "steal from a full deque");
+    expect(deque->push(&tasks[task_deque::capacity]), "push after a steal made room");
+}
+
+// The owner pushes and pops while thieves steal, every task must be taken exactly once
+void test_deque_race()
+{
+    const size_t n = 200000;
+    std::deque<counted_task> tasks;
+    for (size_t i = 0; i < n; ++i)
+        tasks.emplace_back(i);
+
+    std::vector<std::atomic<int>> taken(n);
+    for (auto& t : taken)
+        t.store(0);
+
+    std::unique_ptr<task_deque> deque(new task_deque());
+    std::atomic<bool> done(false);
+
+    auto take = [&](pool_task* task) { taken[static_cast<counted_task*>(task)->index].fetch_add(1); };
+
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 3; ++i) {
+        thieves.emplace_back([&] {
+            while (!done.load()) {
+                if (pool_task* task = deque->steal())
+                    take(task);
+            }
+        });
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        while (!deque->push(&tasks[i])) {
+            if (pool_task* task = deque->pop())
+                take(task);
+        }
+
+        if (i % 3 == 0) {
+            if (pool_task* task = deque->pop())
+                take(task);
+        }
+    }
+
+    while (pool_task* task = deque->pop())
+        take(task);
+
+    done.store(true);
+    for (auto& thief : thieves)
+        thief.join();
+
+    //a thief may win the last task after the owner gave up on it
+    while (pool_task* task = deque->steal())
+        take(task);
+
+    bool once = true;
+    for (auto& t : taken)
+        once = once && t.load() == 1;
+    expect(once, "every task taken exactly once");
+}
+
+long long fork_sum(utils::thread_pool& pool, long long first, long long last)
+{
+    if (last - first <= 64) {
+        long long sum = 0;
+        for (long long i = first; i < last; ++i)
+            sum += i;
+        return sum;
+    }
+
+    const long long mid = first + (last - first) / 2;
+    long long left = 0, right = 0;
+    auto a = [&] { left = fork_sum(pool, first, mid); };
+    auto b = [&] { right = fork_sum(pool, mid, last); };
+    pool.fork(a, b);
+    return left + right;
+}
+
+// Forks nested deeper than the deque holds, the pushes that fail run in place
+void fork_chain(utils::thread_pool& pool, int depth, std::atomic<int>& calls)
+{
+    if (depth == 0)
+        return;
+
+    auto a = [&] { fork_chain(pool, depth - 1, calls); };
+    auto b = [&] { calls.fetch_add(1); };
+    pool.fork(a, b);
+}
+
+void test_fork_join()
+{
+    utils::pool_options options;
+    options.threads = 4;
+    utils::thread_pool pool(options);
+
+    long long sum = 0;
+    pool.run([&] { sum = fork_sum(pool, 0, 1000000); });
+    expect(sum == 1000000LL * 999999 / 2, "fork/join sum");
+
+    std::atomic<int> calls(0);
+    const int depth = (int) task_deque::capacity + 500;
+    pool.run([&] { fork_chain(pool, depth, calls); });
+    expect(calls.load() == depth, "forks past a full deque all run");
+
+    //spawns of an invoker from outside the pool run on it
+    int a = 0, b = 0;
+    utils::pool_invoker invoker(pool);
+    invoker([&] { a = utils::thread_pool::current() == &pool; }, [&] { b = utils::thread_pool::current() == &pool; });
+    expect(a && b, "pool_invoker runs on the pool");
+}
+
+void test_exceptions()
+{
+    utils::pool_options options;
+    options.threads = 4;
+    utils::thread_pool pool(options);
+
+    bool caught = false;
+    try {
+        pool.run([] { throw std::runtime_error("run"); });
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    expect(caught, "exception of run");
+
+    //from the spawned function, whether it was stolen or popped back
+    for (int i = 0; i < 100; ++i) {
+        caught = false;
+        std::atomic<int> finished(0);
+        try {
+            pool.run([&] {
+                auto a = [&] { fork_sum(pool, 0, 100000); finished.fetch_add(1); };
+                auto b = [&] { throw std::logic_error("spawned"); };
+                pool.fork(a, b);
+            });
+        } catch (const std::logic_error&) {
+            caught = true;
+        }
+        expect(caught && finished.load() == 1, "exception of a spawned function, after its sibling finished");
+    }
+
+    //from the function run in place; a stolen sibling is waited for before it propagates, one not stolen is dropped
+    for (int i = 0; i < 100; ++i) {
+        caught = false;
+        std::atomic<int> finished(0);
+        try {
+            pool.run([&] {
+                auto a = [&] { throw std::logic_error("first"); };
+                auto b = [&] { fork_sum(pool, 0, 100000); finished.fetch_add(1); };
+                pool.fork(a, b);
+            });
+        } catch (const std::logic_error&) {
+            caught = true;
+        }
+        expect(caught && finished.load() <= 1, "exception of the first function");
+    }
+
+    long long sum = 0;
+    pool.run([&] { sum = fork_sum(pool, 0, 1000); });
+    expect(sum == 1000LL * 999 / 2, "pool works after exceptions");
+}
+
+// Counts the comparisons made off the calling thread and the workers of the pool
+struct pool_cmp {
+    utils::thread_pool* pool;
+    std::thread::id caller;
+    std::atomic<int>* strangers;
+
+    bool operator()(int a, int b) const
+    {
+        if (utils::thread_pool::current() != pool && std::this_thread::get_id() != caller)
+            strangers->fetch_add(1, std::memory_order_relaxed);
+        return a < b;
+    }
+};
+
+using pool_sorter = sort::sorter<int, utils::pool_invoker>;
+using pool_path_sorter = sort::sorter<int, utils::pool_invoker, 8192,
+                                      merge::merger_settings<merge::auto_merger, merge::merge_path_partition<>>>;
+
+template<typename Sort>
+void check_on_pool(const char* name, utils::thread_pool& pool, const std::vector<int>& input, Sort sort)
+{
+    std::atomic<int> strangers(0);
+    const pool_cmp cmp = { &pool, std::this_thread::get_id(), &strangers };
+
+    std::vector<int> a = input;
+    pool.run([&] { sort(a, cmp); });
+    expect(std::is_sorted(a.begin(), a.end()) && strangers.load() == 0, name);
+}
+
+struct merge_sort_on_pool {
+    void operator()(std::vector<int>& a, pool_cmp cmp) const { pool_sorter::merge_sort(a.begin(), a.end(), cmp); }
+};
+
+struct merge_path_sort_on_pool {
+    void operator()(std::vector<int>& a, pool_cmp cmp) const { pool_path_sorter::merge_sort(a.begin(), a.end(), cmp); }
+};
+
+struct sample_sort_on_pool {
+    void operator()(std::vector<int>& a, pool_cmp cmp) const { pool_sorter::sample_sort(a.begin(), a.end(), cmp); }
+};
+
+struct multiway_sort_on_pool {
+    void operator()(std::vector<int>& a, pool_cmp cmp) const { pool_sorter::multiway_merge_sort(a.begin(), a.end(), cmp); }
+};
+
+struct natural_sort_on_pool {
+    void operator()(std::vector<int>& a, pool_cmp cmp) const { pool_sorter::natural_merge_sort(a.begin(), a.end(), cmp); }
+};
+
+// Sorts on a pool_invoker compare only on the calling thread and the workers of the pool, none on TBB threads
+void test_sorts_stay_on_pool()
+{
+    utils::pool_options options;
+    options.threads = 3;
+    utils::thread_pool pool(options);
+
+    std::mt19937_64 rng(7);
+    std::vector<int> input(1 << 21);
+    for (auto& x : input)
+        x = (int) (rng() % 100000);
+
+    check_on_pool("merge_sort on the pool", pool, input, merge_sort_on_pool());
+    check_on_pool("merge path merge_sort on the pool", pool, input, merge_path_sort_on_pool());
+    check_on_pool("sample_sort on the pool", pool, input, sample_sort_on_pool());
+    check_on_pool("multiway_merge_sort on the pool", pool, input, multiway_sort_on_pool());
+    check_on_pool("natural_merge_sort on the pool", pool, input, natural_sort_on_pool());
+}
+
+// Radix sorts on a pool_invoker count and scatter their chunks as pool tasks
+void test_radix_on_pool()
+{
+    utils::pool_options options;
+    options.threads = 3;
+    utils::thread_pool pool(options);
+
+    std::mt19937_64 rng(13);
+    std::vector<int> input(1 << 21);
+    for (auto& x : input)
+        x = (int) rng();
+
+    std::vector<int> expected = input;
+    std::sort(expected.begin(), expected.end());
+
+    std::vector<int> a = input;
+    pool.run([&] { sort::radix_sorter<int, utils::pool_invoker>::radix_sort(a.begin(), a.end()); });
+    expect(a == expected, "radix_sort on the pool");
+
+    a = input;
+    pool.run([&] { sort::radix_leaf_sorter<int, utils::pool_invoker>::merge_sort(a.begin(), a.end()); });
+    expect(a == expected, "radix leaf merge_sort on the pool");
+}
+
+// Async sorts started on a pool run their phases and continuations as pool tasks, no TBB worker waits for them
+void test_async_on_pool()
+{
+    utils::pool_options options;
+    options.threads = 3;
+    utils::thread_pool pool(options);
+
+    std::mt19937_64 rng(11);
+    std::vector<int> a(1 << 21);
+    for (auto& x : a)
+        x = (int) (rng() % 100000);
+
+    std::atomic<int> strangers(0);
+    const pool_cmp cmp = { &pool, std::this_thread::get_id(), &strangers };
+    std::atomic<bool> continued_on_pool(false);
+
+    async::handle sorted, done;
+    pool.run([&] {
+        sorted = pool_sorter::merge_sort_async(a.begin(), a.end(), cmp);
+        done = sorted.then([&] { continued_on_pool = utils::thread_pool::current() == &pool; });
+    });
+    done.get();
+
+    expect(std::is_sorted(a.begin(), a.end()) && strangers.load() == 0, "merge_sort_async on the pool");
+    expect(continued_on_pool.load(), "then() of an async sort on the pool");
+}
+
+int main()
+{
+    test_deque();
+    test_deque_race();
+    test_fork_join();
+    test_exceptions();
+    test_sorts_stay_on_pool();
+    test_radix_on_pool();
+    test_async_on_pool();
+
+    std::cout << "Thread pool: " << (failures ? "failed" : "ok") << std::endl;
+    return failures ? 1 : 0;
+}
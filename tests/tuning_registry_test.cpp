@@ -0,0 +1,104 @@
+//
+// Processes storing into one tuning file at the same time keep each other's entries and those of other hosts.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "tuning.hpp"
+
+using namespace sal;
+
+static const int processes = 4;
+static const int keys_per_process = 25;
+
+static std::string key(int process, int i)
+{
+    return "process" + std::to_string(process) + "\tkey" + std::to_string(i);
+}
+
+// Every child reads the file before any of them stores, so a store that only wrote what its process read would drop the others
+static void child(int process, int ready, int go)
+{
+    tuning::registry& registry = tuning::registry::instance();
+
+    char byte = 0;
+    if (write(ready, &byte, 1) != 1 || read(go, &byte, 1) != 1)
+        _exit(2);
+
+    for (int i = 0; i < keys_per_process; ++i) {
+        tuning::tuned_values values = { 4096, 4096, 8192 };
+        if (!registry.store(key(process, i), values))
+            _exit(1);
+    }
+
+    _exit(0);
+}
+
+int main()
+{
+    const std::string path = "tuning_registry_test.txt";
+    setenv(tuning::tuning_file_env, path.c_str(), 1);
+
+    {
+        std::ofstream file(path);
+        file << "other host\tint\tmerger\t2048\t2048\t4096\n";
+    }
+
+    int ready[2], go[2];
+    if (pipe(ready) != 0 || pipe(go) != 0)
+        return 1;
+
+    for (int p = 0; p < processes; ++p) {
+        if (fork() == 0)
+            child(p, ready[1], go[0]);
+    }
+
+    //one byte from every child once its registry read the file, then one byte to release each
+    char byte = 0;
+    bool ok = true;
+    for (int p = 0; p < processes && ok; ++p)
+        ok = read(ready[0], &byte, 1) == 1;
+    for (int p = 0; p < processes && ok; ++p)
+        ok = write(go[1], &byte, 1) == 1;
+
+    for (int p = 0; p < processes; ++p) {
+        int status = 0;
+        wait(&status);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    if (!ok)
+        std::cout << "FAIL a process could not store" << std::endl;
+
+    //the registry of this process reads the file only now
+    int missing = 0;
+    for (int p = 0; p < processes; ++p) {
+        for (int i = 0; i < keys_per_process; ++i) {
+            tuning::tuned_values values;
+            if (!tuning::registry::instance().find(key(p, i), values))
+                ++missing;
+        }
+    }
+
+    bool other_host = false;
+    std::ifstream file(path);
+    for (std::string line; std::getline(file, line);)
+        other_host = other_host || line.compare(0, 10, "other host") == 0;
+
+    if (missing)
+        std::cout << "FAIL " << missing << " entries lost" << std::endl;
+    if (!other_host)
+        std::cout << "FAIL entry of another host lost" << std::endl;
+
+    std::remove(path.c_str());
+    std::remove((path + ".lock").c_str());
+
+    ok = ok && !missing && other_host;
+    std::cout << "Tuning registry: " << (ok ? "ok" : "failed") << std::endl;
+    return ok ? 0 : 1;
+}
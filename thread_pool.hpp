@@ -0,0 +1,465 @@
+//
+// Work-stealing thread pool and its invoker, a parallel backend without TBB.
+//
+
+#ifndef SAL_THREAD_POOL_HPP
+#define SAL_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace sal { namespace utils {
+
+struct pool_options {
+    unsigned threads = 0;       // workers, 0 for one per cpu of the mask or per hardware thread
+    std::vector<int> cpus;      // affinity mask, worker i is pinned to cpus[i % size]; empty leaves the workers unpinned
+};
+
+class thread_pool;
+
+namespace internal {
+
+// A spawned function, lives in the frame of the thread that spawned it until it is done
+struct pool_task {
+    void (*run)(pool_task*);
+    std::atomic<bool> done;
+    std::exception_ptr error;
+    pool_task* next;            // queue of the tasks submitted from outside the pool
+    void (*release)(pool_task*);    // frees a task nobody waits for once it ran, nullptr for the others
+
+    explicit pool_task(void (*r)(pool_task*)) : run(r), done(false), next(nullptr), release(nullptr) { }
+};
+
+template<typename Fun>
+struct fun_task : pool_task {
+    Fun& fun;
+
+    explicit fun_task(Fun& f) : pool_task(&fun_task::invoke), fun(f) { }
+
+    static void invoke(pool_task* task) { static_cast<fun_task*>(task)->fun(); }
+};
+
+// A submitted function nobody waits for, owned by the pool from submission on
+template<typename Fun>
+struct owned_task : pool_task {
+    Fun fun;
+
+    explicit owned_task(Fun f) : pool_task(&owned_task::invoke), fun(std::move(f)) { release = &owned_task::destroy; }
+
+    static void invoke(pool_task* task) { static_cast<owned_task*>(task)->fun(); }
+
+    static void destroy(pool_task* task) { delete static_cast<owned_task*>(task); }
+};
+
+// Runs a task taken from a deque or the submission queue; done is the last write to it
+inline void execute(pool_task* task)
+{
+    try {
+        task->run(task);
+    } catch (...) {
+        task->error = std::current_exception();
+    }
+    task->done.store(true, std::memory_order_release);
+}
+
+/**
+ * Chase-Lev deque of a worker, after Lê, Pop, Cohen and Zappa Nardelli, "Correct and efficient
+ * work-stealing for weak memory models". The owner pushes and pops at the bottom, thieves take
+ * from the top. The array is fixed, a push into a full deque fails and the caller runs the task itself.
+ */
+class task_deque {
+public:
+    static constexpr std::int64_t capacity = 1 << 12;
+
+    task_deque() : top_(0), bottom_(0)
+    {
+        for (auto& slot : slots_)
+            slot.store(nullptr, std::memory_order_relaxed);
+    }
+
+    bool push(pool_task* task)
+    {
+        const std::int64_t b = bottom_.load(std::memory_order_relaxed);
+        const std::int64_t t = top_.load(std::memory_order_acquire);
+        if (b - t >= capacity)
+            return false;
+
+        slots_[b & (capacity - 1)].store(task, std::memory_order_relaxed);
+        bottom_.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    pool_task* pop()
+    {
+        const std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top_.load(std::memory_order_relaxed);
+
+        pool_task* task = nullptr;
+        if (t <= b) {
+            task = slots_[b & (capacity - 1)].load(std::memory_order_relaxed);
+            if (t == b) {
+                //last task, race the thieves for it
+                if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    task = nullptr;
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+        } else {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+
+        return task;
+    }
+
+    pool_task* steal()
+    {
+        std::int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+
+        pool_task* task = slots_[t & (capacity - 1)].load(std::memory_order_relaxed);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+
+        return task;
+    }
+
+private:
+    //thieves write top, the owner bottom, keep them on separate cache lines
+    std::atomic<std::int64_t> top_;
+    char padding_[64 - sizeof(std::atomic<std::int64_t>)];
+    std::atomic<std::int64_t> bottom_;
+    std::atomic<pool_task*> slots_[capacity];
+};
+
+struct pool_worker {
+    thread_pool* pool;
+    unsigned index;
+    std::uint64_t seed;
+    task_deque deque;
+};
+
+inline pool_worker*& current_worker()
+{
+    static thread_local pool_worker* worker = nullptr;
+    return worker;
+}
+
+}
+
+/**
+ * Fixed set of worker threads, each with a Chase-Lev deque, optionally pinned to a set of cpus.
+ * Spawning pushes a task frame that lives on the spawning thread's stack, so no spawn allocates.
+ * Threads outside the pool submit work with run() and block until it is done, or with submit()
+ * without waiting; the work itself only runs on the workers. Idle workers sleep while no submitted work is in flight.
+ */
+class thread_pool {
+public:
+    explicit thread_pool(const pool_options& options = pool_options()) : stop_(false), active_(0), queue_(nullptr), tail_(nullptr)
+    {
+        unsigned threads = options.threads;
+        if (!threads)
+            threads = options.cpus.empty() ? std::thread::hardware_concurrency() : (unsigned) options.cpus.size();
+        if (!threads)
+            threads = 1;
+
+        for (unsigned i = 0; i < threads; ++i) {
+            workers_.emplace_back(new internal::pool_worker());
+            workers_.back()->pool = this;
+            workers_.back()->index = i;
+            workers_.back()->seed = 0x9e3779b97f4a7c15ull * (i + 1);
+        }
+
+        for (unsigned i = 0; i < threads; ++i) {
+            const int cpu = options.cpus.empty() ? -1 : options.cpus[i % options.cpus.size()];
+            threads_.emplace_back([this, i, cpu] { work(*workers_[i], cpu); });
+        }
+    }
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_)
+            thread.join();
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    unsigned size() const { return (unsigned) workers_.size(); }
+
+    // Pool of the calling worker thread, nullptr outside of any pool
+    static thread_pool* current()
+    {
+        internal::pool_worker* worker = internal::current_worker();
+        return worker ? worker->pool : nullptr;
+    }
+
+    // Pool of default constructed pool_invokers outside of any pool, one worker per hardware thread
+    static thread_pool& default_pool()
+    {
+        static thread_pool pool;
+        return pool;
+    }
+
+    // Runs f on a worker and returns when it is done, rethrowing its exception; runs it in place on a worker of this pool
+    template<typename F>
+    void run(F&& f)
+    {
+        if (current() == this) {
+            f();
+            return;
+        }
+
+        internal::fun_task<F> task(f);
+        _submit(&task);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            finished_.wait(lock, [&] { return task.done.load(std::memory_order_acquire); });
+        }
+
+        if (task.error)
+            std::rethrow_exception(task.error);
+    }
+
+    // Queues f on a worker and returns at once, from any thread; an exception of f is dropped
+    template<typename F>
+    void submit(F f)
+    {
+        _submit(new internal::owned_task<F>(std::move(f)));
+    }
+
+    /**
+     * Runs the functions in parallel on the calling worker, which must belong to this pool. The
+     * worker runs the first function at once and leaves the others on its deque, where idle
+     * workers steal them, so the continuation of the spawn is what gets stolen. Afterwards it
+     * pops back what was not stolen and helps with other tasks while waiting for the rest.
+     */
+    template<typename Fun, typename ...Funs>
+    void fork(Fun& fun, Funs&... funs)
+    {
+        _fork(*internal::current_worker(), fun, funs...);
+    }
+
+private:
+    void _submit(internal::pool_task* task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (tail_)
+                tail_->next = task;
+            else
+                queue_ = task;
+            tail_ = task;
+            ++active_;
+        }
+        wake_.notify_all();
+    }
+
+    template<typename Fun>
+    void _fork(internal::pool_worker&, Fun& fun)
+    {
+        fun();
+    }
+
+    template<typename First, typename Fun, typename ...Funs>
+    void _fork(internal::pool_worker& worker, First& first, Fun& fun, Funs&... funs)
+    {
+        internal::fun_task<Fun> task(fun);
+        if (!worker.deque.push(&task)) {
+            _fork(worker, first, funs...);
+            fun();
+            return;
+        }
+
+        try {
+            _fork(worker, first, funs...);
+        } catch (...) {
+            _join(worker, task, false);
+            throw;
+        }
+
+        _join(worker, task, true);
+        if (task.error)
+            std::rethrow_exception(task.error);
+    }
+
+    // Spawns and joins nest, so the bottom of the deque is task unless a thief took it; a task not stolen is dropped unless run
+    void _join(internal::pool_worker& worker, internal::pool_task& task, bool run)
+    {
+        internal::pool_task* own = worker.deque.pop();
+        if (own) {
+            if (run)
+                internal::execute(own);
+            return;
+        }
+
+        while (!task.done.load(std::memory_order_acquire)) {
+            internal::pool_task* stolen = _steal(worker);
+            if (stolen)
+                internal::execute(stolen);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    internal::pool_task* _steal(internal::pool_worker& worker)
+    {
+        const std::size_t n = workers_.size();
+        if (n < 2)
+            return nullptr;
+
+        //xorshift, a random first victim spreads the thieves
+        worker.seed ^= worker.seed << 13;
+        worker.seed ^= worker.seed >> 7;
+        worker.seed ^= worker.seed << 17;
+        const std::size_t first = (std::size_t) (worker.seed % n);
+
+        for (std::size_t k = 0; k < n; ++k) {
+            const std::size_t victim = (first + k) % n;
+            if (victim == worker.index)
+                continue;
+
+            internal::pool_task* task = workers_[victim]->deque.steal();
+            if (task)
+                return task;
+        }
+
+        return nullptr;
+    }
+
+    internal::pool_task* _take_submitted()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        internal::pool_task* task = queue_;
+        if (task) {
+            queue_ = task->next;
+            if (!queue_)
+                tail_ = nullptr;
+        }
+        return task;
+    }
+
+    void work(internal::pool_worker& worker, int cpu)
+    {
+#ifdef __linux__
+        if (cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+#else
+        (void) cpu;
+#endif
+        internal::current_worker() = &worker;
+
+        for (;;) {
+            internal::pool_task* task = _steal(worker);
+            if (task) {
+                internal::execute(task);
+                continue;
+            }
+
+            task = _take_submitted();
+            if (task) {
+                //the frame of a waited for task may be gone once it is done
+                void (*release)(internal::pool_task*) = task->release;
+                internal::execute(task);
+                if (release)
+                    release(task);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    --active_;
+                }
+                finished_.notify_all();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (stop_)
+                return;
+
+            if (active_ == 0) {
+                wake_.wait(lock, [&] { return stop_ || active_ > 0; });
+            } else {
+                //submitted work is running, one of its spawns may show up soon
+                lock.unlock();
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<internal::pool_worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable finished_;
+    bool stop_;
+    unsigned active_;
+    internal::pool_task* queue_;
+    internal::pool_task* tail_;
+};
+
+/**
+ * Invoker running on a thread_pool, interchangeable with parallel_invoker as the Invoker of
+ * sorter and merger. Default constructed it uses the pool of the calling worker or, outside of
+ * any pool, thread_pool::default_pool(); to sort on a pinned pool, call the sort inside
+ * pool.run() or pass a pool_invoker(pool) to the functions taking one.
+ */
+struct pool_invoker {
+    pool_invoker() : pool(thread_pool::current())
+    {
+        if (!pool)
+            pool = &thread_pool::default_pool();
+    }
+
+    explicit pool_invoker(thread_pool& p) : pool(&p) { }
+
+    template<typename ...Funs>
+    void operator()(Funs&&... funs) {
+        if (thread_pool::current() == pool)
+            pool->fork(funs...);
+        else
+            pool->run([&] { pool->fork(funs...); });
+    }
+
+    // Queues f on the pool without waiting for it, the scheduler of the async entries on this invoker
+    template<typename F>
+    void enqueue(F f) {
+        pool->submit(std::move(f));
+    }
+
+    thread_pool* pool;
+};
+
+// Threads of the pool, for cutoff_invoker<pool_invoker>
+inline std::size_t concurrency(const pool_invoker& invoker)
+{
+    return invoker.pool->size();
+}
+
+}}
+
+#endif //SAL_THREAD_POOL_HPP
@@ -0,0 +1,304 @@
+//
+// Timeline of the sort and merge tasks, exported as Chrome trace events.
+//
+
+#ifndef SAL_TRACE_HPP
+#define SAL_TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "stats.hpp"
+
+namespace sal { namespace trace {
+
+enum class phase : std::uint8_t {
+    leaf_sort,      // one BlockSorter call
+    merge,          // one merge of the sort recursion, including the pieces it hands to other threads
+    block_merge     // one BlockMerger call of a merge
+};
+
+inline const char* phase_name(phase p)
+{
+    static const char* const names[] = { "leaf_sort", "merge", "block_merge" };
+    return names[static_cast<int>(p)];
+}
+
+struct event {
+    std::uint64_t begin_ns;
+    std::uint64_t end_ns;
+    std::uint64_t keys;
+    std::uint32_t depth;
+    phase what;
+};
+
+// Events kept per thread, older ones are overwritten
+constexpr std::size_t ring_capacity = 1 << 14;
+
+/**
+ * Event ring of one thread. Only the owning thread writes, without locks or read-modify-write
+ * operations. Every slot carries a sequence number that is odd while the owner writes the slot,
+ * so a reader copying a slot the owner is overwriting sees the number change and drops the copy.
+ */
+class ring {
+public:
+    explicit ring(std::uint32_t thread) : slots_(new slot[ring_capacity]()), head_(0), thread_(thread) { }
+
+    void push(const event& e)
+    {
+        const std::uint64_t head = head_.load(std::memory_order_relaxed);
+        slot& s = slots_[head & (ring_capacity - 1)];
+
+        s.sequence.store(2 * head + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s.begin_ns.store(e.begin_ns, std::memory_order_relaxed);
+        s.end_ns.store(e.end_ns, std::memory_order_relaxed);
+        s.keys.store(e.keys, std::memory_order_relaxed);
+        s.depth.store(e.depth, std::memory_order_relaxed);
+        s.what.store(static_cast<std::uint8_t>(e.what), std::memory_order_relaxed);
+        s.sequence.store(2 * head + 2, std::memory_order_release);
+
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    std::uint64_t head() const { return head_.load(std::memory_order_acquire); }
+
+    // Copies the event pushed at position, false when the owner overwrote it or is writing its slot
+    bool read(std::uint64_t position, event& e) const
+    {
+        const slot& s = slots_[position & (ring_capacity - 1)];
+        const std::uint64_t sequence = s.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * position + 2)
+            return false;
+
+        e.begin_ns = s.begin_ns.load(std::memory_order_relaxed);
+        e.end_ns = s.end_ns.load(std::memory_order_relaxed);
+        e.keys = s.keys.load(std::memory_order_relaxed);
+        e.depth = s.depth.load(std::memory_order_relaxed);
+        e.what = static_cast<phase>(s.what.load(std::memory_order_relaxed));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return s.sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+    std::uint32_t thread() const { return thread_; }
+
+private:
+    //fields are relaxed atomics so a copy racing the owner is not a data race, only a stale copy
+    struct slot {
+        std::atomic<std::uint64_t> sequence;
+        std::atomic<std::uint64_t> begin_ns;
+        std::atomic<std::uint64_t> end_ns;
+        std::atomic<std::uint64_t> keys;
+        std::atomic<std::uint32_t> depth;
+        std::atomic<std::uint8_t> what;
+    };
+
+    std::unique_ptr<slot[]> slots_;
+    std::atomic<std::uint64_t> head_;
+    std::uint32_t thread_;
+};
+
+namespace internal {
+
+// Rings live until the end of the process so threads may exit before their events are read
+struct registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ring>> rings;
+
+    static registry& instance()
+    {
+        static registry r;
+        return r;
+    }
+};
+
+inline ring& this_thread_ring()
+{
+    static thread_local ring* r = nullptr;
+    if (!r) {
+        registry& reg = registry::instance();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.rings.emplace_back(new ring(static_cast<std::uint32_t>(reg.rings.size())));
+        r = reg.rings.back().get();
+    }
+
+    return *r;
+}
+
+// Number of recordings in progress, events are only taken while it is not zero
+inline std::atomic<int>& recordings()
+{
+    static std::atomic<int> count(0);
+    return count;
+}
+
+inline bool enabled()
+{
+    return recordings().load(std::memory_order_relaxed) != 0;
+}
+
+// ns as microseconds with all three decimals, a double at the default stream precision loses them after 1 s
+inline std::string microseconds(std::uint64_t ns)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%llu.%03u", (unsigned long long) (ns / 1000), (unsigned) (ns % 1000));
+    return text;
+}
+
+inline void record(phase what, std::uint64_t begin, std::uint64_t keys, unsigned depth)
+{
+    this_thread_ring().push({ begin, stats::internal::now_ns(), keys, depth, what });
+}
+
+}
+
+/**
+ * Stats policy (see stats.hpp) that records a timeline event per leaf sort, merge and block merge
+ * while a recording is open. With none open each hook costs one relaxed load; with one open an
+ * event costs two clock reads and a store into the thread's ring.
+ */
+struct timeline {
+    static std::uint64_t start() { return internal::enabled() ? stats::internal::now_ns() : 0; }
+
+    static void spawn(unsigned, std::size_t) { }
+    static void merge_spawn(unsigned, std::size_t) { }
+    static void search(std::size_t, std::size_t = 1) { }
+
+    static void leaf(std::size_t n, unsigned depth, std::uint64_t started)
+    {
+        if (started)
+            internal::record(phase::leaf_sort, started, n, depth);
+    }
+
+    static void merge(unsigned depth, std::size_t n, std::size_t, std::uint64_t started)
+    {
+        if (started)
+            internal::record(phase::merge, started, n, depth);
+    }
+
+    static void block_merge(std::size_t n, std::uint64_t started)
+    {
+        if (started)
+            internal::record(phase::block_merge, started, n, 0);
+    }
+};
+
+/**
+ * Records the events of all threads from construction to stop() or destruction. Dump it after
+ * the traced sorts returned; events of other sorts running meanwhile are included, a thread that
+ * produced more than ring_capacity events keeps its latest ones.
+ */
+class recording {
+public:
+    recording() : stopped_(false), begin_ns_(stats::internal::now_ns()), end_ns_(0)
+    {
+        internal::registry& reg = internal::registry::instance();
+        {
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            for (auto& r : reg.rings)
+                starts_.push_back(r->head());
+        }
+
+        internal::recordings().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~recording() { stop(); }
+
+    recording(const recording&) = delete;
+    recording& operator=(const recording&) = delete;
+
+    void stop()
+    {
+        if (stopped_)
+            return;
+
+        stopped_ = true;
+        end_ns_ = stats::internal::now_ns();
+        internal::recordings().fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Events recorded in the window, by thread; while sorts still run, events their threads overwrite during the copy are left out
+    std::vector<std::pair<std::uint32_t, std::vector<event>>> events() const
+    {
+        std::vector<std::pair<std::uint32_t, std::vector<event>>> threads;
+        const std::uint64_t end = stopped_ ? end_ns_ : stats::internal::now_ns();
+
+        internal::registry& reg = internal::registry::instance();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (std::size_t i = 0; i < reg.rings.size(); ++i) {
+            const ring& r = *reg.rings[i];
+            const std::uint64_t head = r.head();
+            std::uint64_t first = i < starts_.size() ? starts_[i] : 0;
+            if (head - first > ring_capacity)
+                first = head - ring_capacity;
+
+            std::vector<event> list;
+            event e;
+            for (std::uint64_t p = first; p < head; ++p) {
+                if (r.read(p, e) && e.begin_ns >= begin_ns_ && e.end_ns <= end)
+                    list.push_back(e);
+            }
+
+            if (!list.empty())
+                threads.emplace_back(r.thread(), std::move(list));
+        }
+
+        return threads;
+    }
+
+    // Trace-event JSON for chrome://tracing and Perfetto, times in microseconds from the start of the recording
+    void write_chrome_trace(std::ostream& out) const
+    {
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        for (auto& thread : events()) {
+            out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.first
+                << ",\"args\":{\"name\":\"thread " << thread.first << "\"}}";
+            first = false;
+
+            for (auto& e : thread.second) {
+                out << ",\n{\"name\":\"" << phase_name(e.what) << "\",\"cat\":\"sal\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                    << thread.first << ",\"ts\":" << internal::microseconds(e.begin_ns - begin_ns_) << ",\"dur\":"
+                    << internal::microseconds(e.end_ns - e.begin_ns) << ",\"args\":{\"keys\":" << e.keys << ",\"depth\":" << e.depth << "}}";
+            }
+        }
+
+        out << "\n]}\n";
+    }
+
+    bool write_chrome_trace(const std::string& path) const
+    {
+        std::ofstream file(path);
+        write_chrome_trace(file);
+        return static_cast<bool>(file);
+    }
+
+private:
+    bool stopped_;
+    std::uint64_t begin_ns_;
+    std::uint64_t end_ns_;
+    std::vector<std::uint64_t> starts_;
+};
+
+// Picks one call out of every, for recording a sample of production sorts
+class sampler {
+public:
+    explicit sampler(unsigned every) : every_(every ? every : 1), calls_(0) { }
+
+    bool sample() { return calls_.fetch_add(1, std::memory_order_relaxed) % every_ == 0; }
+
+private:
+    unsigned every_;
+    std::atomic<std::uint64_t> calls_;
+};
+
+}}
+
+#endif //SAL_TRACE_HPP
@@ -0,0 +1,351 @@
+//
+// Host and element type dependent block sizes for the runtime-configured sorter and partitions.
+//
+
+#ifndef SAL_TUNING_HPP
+#define SAL_TUNING_HPP
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <typeinfo>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace sal { namespace tuning {
+
+// Environment variable naming the file that keeps calibrated values across processes
+constexpr const char* tuning_file_env = "SAL_TUNING_FILE";
+
+struct cache_info {
+    size_t line;
+    size_t l1d;
+    size_t l2;
+    size_t l3;
+};
+
+// Sizes in elements
+struct tuned_values {
+    size_t leaf_size;           // block sorted by the block sorter before merging
+    size_t merge_block_size;    // piece merged sequentially by the divide-and-conquer merge
+    size_t parallel_cutoff;     // smallest piece handed to its own task by the flat partitions
+};
+
+// Bounds of leaf_size and merge_block_size; parallel_cutoff is one to eight merge blocks
+constexpr size_t min_block_size = 1024;
+constexpr size_t max_block_size = 1 << 20;
+constexpr size_t max_cutoff_blocks = 8;
+
+namespace internal {
+
+// Parses sysfs cache sizes such as "48K" or "32M"
+inline size_t parse_size(const std::string& text)
+{
+    size_t value = std::strtoull(text.c_str(), nullptr, 10);
+    switch (text.empty() ? ' ' : text.back()) {
+        case 'K': return value << 10;
+        case 'M': return value << 20;
+        case 'G': return value << 30;
+        default: return value;
+    }
+}
+
+inline std::string read_line(const std::string& path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+inline size_t floor_pow2(size_t x)
+{
+    size_t p = 1;
+    while (p <= x / 2)
+        p *= 2;
+    return p;
+}
+
+inline size_t clamp(size_t x, size_t lo, size_t hi)
+{
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+
+// Values moved into the bounds, a zero leaf size or cutoff from a damaged tuning file would divide by zero
+inline tuned_values bounded(tuned_values values)
+{
+    values.leaf_size = clamp(values.leaf_size, min_block_size, max_block_size);
+    values.merge_block_size = clamp(values.merge_block_size, min_block_size, max_block_size);
+    values.parallel_cutoff = clamp(values.parallel_cutoff, values.merge_block_size, max_cutoff_blocks * values.merge_block_size);
+    return values;
+}
+
+// Exclusive advisory lock on path, created when missing, held for the lifetime of the object; a no-op off Linux
+class file_lock {
+public:
+    explicit file_lock(const std::string& path)
+    {
+#ifdef __linux__
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ >= 0) {
+            while (::flock(fd_, LOCK_EX) != 0 && errno == EINTR) { }
+        }
+#else
+        (void)path;
+#endif
+    }
+
+    ~file_lock()
+    {
+#ifdef __linux__
+        if (fd_ >= 0)
+            ::close(fd_);
+#endif
+    }
+
+    file_lock(const file_lock&) = delete;
+    file_lock& operator=(const file_lock&) = delete;
+
+private:
+    int fd_ = -1;
+};
+
+}
+
+// Data cache hierarchy of cpu0, common desktop sizes where sysfs is not available
+inline cache_info detect_caches()
+{
+    cache_info info = { 64, 32 << 10, 1 << 20, 8 << 20 };
+
+    for (int index = 0; ; ++index) {
+        const std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+        const std::string level = internal::read_line(dir + "level");
+        if (level.empty())
+            break;
+
+        const std::string type = internal::read_line(dir + "type");
+        const size_t size = internal::parse_size(internal::read_line(dir + "size"));
+        const size_t line = internal::parse_size(internal::read_line(dir + "coherency_line_size"));
+        if (type == "Instruction" || size == 0)
+            continue;
+
+        if (line)
+            info.line = line;
+        if (level == "1")
+            info.l1d = size;
+        else if (level == "2")
+            info.l2 = size;
+        else if (level == "3")
+            info.l3 = size;
+    }
+
+    return info;
+}
+
+inline const cache_info& host_caches()
+{
+    static const cache_info caches = detect_caches();
+    return caches;
+}
+
+// Identifies the processor model, cache sizes and thread count calibrated values belong to
+inline const std::string& host_id()
+{
+    static const std::string id = [] {
+        std::string model = "unknown";
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        for (std::string line; std::getline(cpuinfo, line);) {
+            if (line.compare(0, 10, "model name") == 0) {
+                model = line.substr(line.find(':') + 2);
+                break;
+            }
+        }
+
+        const cache_info& caches = host_caches();
+        std::ostringstream id;
+        id << model << '/' << caches.l1d << '/' << caches.l2 << '/' << caches.l3 << '/' << std::thread::hardware_concurrency();
+        return id.str();
+    }();
+
+    return id;
+}
+
+/**
+ * Values derived from the caches alone, used until a calibration for the type and merger ran:
+ * a leaf and the scratch of the block sorter fill half of L2, a sequential merge piece with its
+ * output fills a third of L2 and a task gets at least two merge pieces.
+ */
+inline tuned_values heuristic_values(size_t element_bytes)
+{
+    const cache_info& caches = host_caches();
+
+    tuned_values values;
+    values.leaf_size = internal::clamp(internal::floor_pow2(caches.l2 / 4 / element_bytes), min_block_size, max_block_size);
+    values.merge_block_size = internal::clamp(internal::floor_pow2(caches.l2 / 3 / element_bytes), min_block_size, max_block_size);
+    values.parallel_cutoff = 2 * values.merge_block_size;
+    return values;
+}
+
+// SAL_TUNING_FILE, or sal-tuning.txt in the XDG cache directory
+inline std::string tuning_file()
+{
+    if (const char* path = std::getenv(tuning_file_env))
+        return path;
+    if (const char* cache = std::getenv("XDG_CACHE_HOME"))
+        return std::string(cache) + "/sal-tuning.txt";
+    if (const char* home = std::getenv("HOME"))
+        return std::string(home) + "/.cache/sal-tuning.txt";
+
+    return "sal-tuning.txt";
+}
+
+/**
+ * Calibrated values of this host by element type and merger, kept in the tuning file as one
+ * tab separated line per entry. Values are moved into the bounds when read and stored, and the
+ * file is replaced by a rename so a process reading it never sees half of it. A store holds a
+ * lock on the sibling file <tuning file>.lock while it merges the entries the file has now with
+ * its own and renames, so entries stored meanwhile by other processes and hosts are preserved.
+ */
+class registry {
+public:
+    static registry& instance()
+    {
+        static registry r;
+        return r;
+    }
+
+    bool find(const std::string& key, tuned_values& values)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(host_id() + '\t' + key);
+        if (it == entries_.end())
+            return false;
+
+        values = it->second;
+        return true;
+    }
+
+    // Records the values and rewrites the tuning file, returns false when it cannot be written
+    bool store(const std::string& key, const tuned_values& values)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const std::string path = tuning_file();
+        internal::file_lock file_lock(path + ".lock");
+
+        //the file may have entries other processes stored since it was read, they replace what this one read
+        _read(path, entries_);
+        entries_[host_id() + '\t' + key] = internal::bounded(values);
+
+        const std::string temp = path + ".tmp" + std::to_string(std::random_device()());
+        {
+            std::ofstream file(temp);
+            for (auto& entry : entries_) {
+                file << entry.first << '\t' << entry.second.leaf_size << '\t' << entry.second.merge_block_size << '\t'
+                     << entry.second.parallel_cutoff << '\n';
+            }
+
+            file.close();
+            if (!file) {
+                std::remove(temp.c_str());
+                return false;
+            }
+        }
+
+        if (std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    registry() { _read(tuning_file(), entries_); }
+
+    static void _read(const std::string& path, std::map<std::string, tuned_values>& entries)
+    {
+        std::ifstream file(path);
+        for (std::string line; std::getline(file, line);) {
+            //host, type and merger are the first three fields
+            size_t pos = 0;
+            for (int field = 0; field < 3 && pos != std::string::npos; ++field)
+                pos = line.find('\t', pos + (field ? 1 : 0));
+
+            if (pos == std::string::npos)
+                continue;
+
+            tuned_values values;
+            std::istringstream numbers(line.substr(pos + 1));
+            if (numbers >> values.leaf_size >> values.merge_block_size >> values.parallel_cutoff)
+                entries[line.substr(0, pos)] = internal::bounded(values);
+        }
+    }
+
+    std::mutex mutex_;
+    std::map<std::string, tuned_values> entries_;
+};
+
+template<typename T, typename Merger>
+std::string key()
+{
+    return std::string(typeid(T).name()) + '\t' + typeid(Merger).name();
+}
+
+// Current values of one (type, merger) pair, read on every sort so a calibration takes effect at once
+class tuned_slot {
+public:
+    explicit tuned_slot(const tuned_values& values) { set(values); }
+
+    tuned_values get() const
+    {
+        return { leaf_size_.load(std::memory_order_relaxed), merge_block_size_.load(std::memory_order_relaxed),
+                 parallel_cutoff_.load(std::memory_order_relaxed) };
+    }
+
+    void set(const tuned_values& values)
+    {
+        leaf_size_.store(values.leaf_size, std::memory_order_relaxed);
+        merge_block_size_.store(values.merge_block_size, std::memory_order_relaxed);
+        parallel_cutoff_.store(values.parallel_cutoff, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> leaf_size_;
+    std::atomic<size_t> merge_block_size_;
+    std::atomic<size_t> parallel_cutoff_;
+};
+
+// Calibrated values from the tuning file, or the cache heuristic when there are none
+template<typename T, typename Merger>
+tuned_slot& slot()
+{
+    static tuned_slot s([] {
+        tuned_values values = heuristic_values(sizeof(T));
+        registry::instance().find(key<T, Merger>(), values);
+        return values;
+    }());
+
+    return s;
+}
+
+template<typename T, typename Merger>
+tuned_values values()
+{
+    return slot<T, Merger>().get();
+}
+
+}}
+
+#endif //SAL_TUNING_HPP
@@ -8,17 +8,27 @@
 #include <cmath>
 #include <algorithm>
 #include <type_traits>
-#include <tbb/tbb.h>
 #include <future>
+#include <iterator>
+#include <thread>
 #include "aligned_allocator.hpp"
+#include "dispatch.hpp"
+#ifdef SAL_NO_TBB
+#include "thread_pool.hpp"
+#else
+#include <tbb/tbb.h>
+#endif
 
 namespace sal { namespace utils {
+// Built with SAL_NO_TBB, parallel_invoker is pool_invoker (see numa.hpp), so the default sorters run on thread_pool
+#ifndef SAL_NO_TBB
 struct parallel_invoker {
     template<typename ...Funs>
     void operator()(Funs... funs) {
         tbb::parallel_invoke(funs...);
     }
 };
+#endif
 
 struct serial_invoker {
     template<typename ...Funs>
@@ -40,6 +50,110 @@ private:
 
 };
 
+// Threads an invoker runs its functions on, every invoker answers for itself; unknown ones get a thread per hardware thread
+template<typename Invoker>
+inline size_t concurrency(const Invoker &) {
+    return std::max((size_t) 1, (size_t) std::thread::hardware_concurrency());
+}
+
+#ifndef SAL_NO_TBB
+inline size_t concurrency(const parallel_invoker &) {
+    return (size_t) tbb::this_task_arena::max_concurrency();
+}
+#endif
+
+inline size_t concurrency(const serial_invoker &) {
+    return 1;
+}
+
+// Defined by thread_pool.hpp, declared here so that sorters included before it still call it
+struct pool_invoker;
+inline size_t concurrency(const pool_invoker &invoker);
+
+// Whether an invoker runs its functions one after the other on the calling thread
+template<typename Invoker>
+inline bool is_serial(const Invoker &) {
+    return std::is_same<Invoker, serial_invoker>::value;
+}
+
+// Invoker for the halves of a subproblem of n keys at recursion depth; only cutoff_invoker changes
+template<typename Invoker>
+inline Invoker subproblem(const Invoker &invoker, size_t, unsigned) {
+    return invoker;
+}
+
+/**
+ * Runs Inner down to a task cutoff and everything below it inline. The first subproblem it
+ * sees, the whole input, sets the cutoff to n / (threads * Oversubscription) keys, so every
+ * thread gets about Oversubscription tasks to balance; deeper than MaxDepth is inline as well.
+ * The cutoff only bounds the task count, the leaf size of the sorter and the merge block size
+ * still bound the work of the block sorter and merger.
+ */
+template<typename Inner = parallel_invoker, size_t Oversubscription = 8, unsigned MaxDepth = 32>
+struct cutoff_invoker {
+    Inner inner;
+    size_t cutoff = 0;      // subproblems up to cutoff keys run inline, 0 until the first subproblem
+    bool serial = false;
+
+    template<typename ...Funs>
+    void operator()(Funs... funs) {
+        if (serial)
+            serial_invoker()(funs...);
+        else
+            inner(funs...);
+    }
+
+    // The queue of Inner for the async entries, where it has one
+    template<typename F>
+    auto enqueue(F f) -> decltype(inner.enqueue(std::move(f))) {
+        return inner.enqueue(std::move(f));
+    }
+};
+
+template<typename Inner, size_t Oversubscription, unsigned MaxDepth>
+inline size_t concurrency(const cutoff_invoker<Inner, Oversubscription, MaxDepth> &invoker) {
+    return invoker.serial ? 1 : concurrency(invoker.inner);
+}
+
+template<typename Inner, size_t Oversubscription, unsigned MaxDepth>
+inline bool is_serial(const cutoff_invoker<Inner, Oversubscription, MaxDepth> &invoker) {
+    return invoker.serial || is_serial(invoker.inner);
+}
+
+template<typename Inner, size_t Oversubscription, unsigned MaxDepth>
+inline cutoff_invoker<Inner, Oversubscription, MaxDepth>
+subproblem(const cutoff_invoker<Inner, Oversubscription, MaxDepth> &invoker, size_t n, unsigned depth) {
+    cutoff_invoker<Inner, Oversubscription, MaxDepth> result = invoker;
+    if (!result.cutoff)
+        result.cutoff = std::max((size_t) 1, n / (Oversubscription * concurrency(invoker.inner)));
+
+    result.serial = result.serial || n <= result.cutoff || depth >= MaxDepth;
+    return result;
+}
+
+// Runs f(i) for every i in [first, last) as tasks of invoker, splitting the range in halves
+template<typename Invoker, typename Fun>
+void parallel_for(Invoker invoker, size_t first, size_t last, const Fun &fun) {
+    if (last - first <= 1) {
+        if (first < last)
+            fun(first);
+        return;
+    }
+
+    size_t mid = first + (last - first) / 2;
+    invoker(
+            [&]{parallel_for(invoker, first, mid, fun);},
+            [&]{parallel_for(invoker, mid, last, fun);}
+    );
+}
+
+#ifndef SAL_NO_TBB
+template<typename Fun>
+void parallel_for(parallel_invoker, size_t first, size_t last, const Fun &fun) {
+    tbb::parallel_for(first, last, fun);
+}
+#endif
+
 template<typename RandomAccessIterator>
 typename std::iterator_traits<RandomAccessIterator>::value_type *
 iterator2pointer(RandomAccessIterator it) {
@@ -121,7 +235,20 @@ inline size_t binary_search(T value, const T *a, size_t left, size_t right) {
     return high;
 }
 
-inline void _print_register(const __m256i &m, const char *label) {
+// The same search in the order of cmp, value <= a[mid] becomes !cmp(a[mid], value)
+template<class T, typename Comparator>
+inline size_t binary_search(T value, const T *a, size_t left, size_t right, Comparator cmp) {
+    size_t low = left;
+    size_t high = std::max(left, right + 1);
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (!cmp(a[mid], value)) high = mid;
+        else low = mid + 1;
+    }
+    return high;
+}
+
+SAL_TARGET_AVX2 inline void _print_register(const __m256i &m, const char *label) {
     int v[8] = {};
     _mm256_storeu_si256((__m256i *) v, m);
     std::cout << label << ": { ";
@@ -133,7 +260,7 @@ inline void _print_register(const __m256i &m, const char *label) {
     std::cout << " }" << std::endl;
 }
 
-inline void _print_register128(const __m128i &m, const char *label) {
+SAL_TARGET_SSE4 inline void _print_register128(const __m128i &m, const char *label) {
     int v[4] = {};
     _mm_storeu_si128((__m128i *) v, m);
     std::cout << label << ": { ";
@@ -0,0 +1,118 @@
+//
+// Scratch memory kept by the caller across sorts.
+//
+
+#ifndef SAL_WORKSPACE_HPP
+#define SAL_WORKSPACE_HPP
+
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <immintrin.h>
+#include "numa.hpp"
+#include "pages.hpp"
+
+namespace sal { namespace sort {
+
+/**
+ * Grow-only scratch buffer for the sorter entry points that take a workspace. The memory is not
+ * value-initialized; when it grows every page is first touched by the threads of the invoker of
+ * the sorter that grows it, so repeated sorts neither allocate nor take page faults. Large workspaces are backed by transparent huge pages.
+ * Not thread safe, use one workspace per concurrent sort.
+ */
+class sort_workspace {
+    using memory = pages::transparent_huge_pages<>;
+
+public:
+    static constexpr size_t page_size = numa::page_size;
+    static constexpr size_t alignment = 64;
+
+    sort_workspace() : data_(nullptr), capacity_(0) { }
+
+    template<typename Invoker = utils::parallel_invoker>
+    explicit sort_workspace(size_t bytes, Invoker invoker = Invoker()) : sort_workspace() { reserve(bytes, invoker); }
+
+    sort_workspace(const sort_workspace &) = delete;
+    sort_workspace &operator=(const sort_workspace &) = delete;
+
+    sort_workspace(sort_workspace &&other) : data_(other.data_), capacity_(other.capacity_)
+    {
+        other.data_ = nullptr;
+        other.capacity_ = 0;
+    }
+
+    sort_workspace &operator=(sort_workspace &&other)
+    {
+        std::swap(data_, other.data_);
+        std::swap(capacity_, other.capacity_);
+        return *this;
+    }
+
+    ~sort_workspace() { release(); }
+
+    size_t capacity() const { return capacity_; }
+
+    // Grows the buffer to at least bytes, the old contents are not kept
+    template<typename Invoker = utils::parallel_invoker>
+    void reserve(size_t bytes, Invoker invoker = Invoker())
+    {
+        if (bytes <= capacity_)
+            return;
+
+        release();
+
+        const size_t size = (bytes + page_size - 1) / page_size * page_size;
+        data_ = static_cast<char *>(memory::allocate(size, page_size));
+        if (!data_)
+            throw std::bad_alloc();
+
+        capacity_ = size;
+        numa::first_touch(data_, size, invoker);
+    }
+
+    void release()
+    {
+        if (data_)
+            memory::deallocate(data_, capacity_);
+
+        data_ = nullptr;
+        capacity_ = 0;
+    }
+
+    // Uninitialized room for n values of T
+    template<typename T>
+    T *scratch(size_t n) { return scratch<T>(n, utils::parallel_invoker()); }
+
+    template<typename T, typename Invoker>
+    T *scratch(size_t n, Invoker invoker)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "sort_workspace holds trivially copyable types only");
+
+        reserve(n * sizeof(T), invoker);
+        return reinterpret_cast<T *>(data_);
+    }
+
+    // Uninitialized room for n keys and n values, the values start on their own cache line
+    template<typename K, typename V>
+    std::pair<K *, V *> scratch(size_t n) { return scratch<K, V>(n, utils::parallel_invoker()); }
+
+    template<typename K, typename V, typename Invoker>
+    std::pair<K *, V *> scratch(size_t n, Invoker invoker)
+    {
+        static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                      "sort_workspace holds trivially copyable types only");
+
+        const size_t keys = (n * sizeof(K) + alignment - 1) / alignment * alignment;
+        reserve(keys + n * sizeof(V), invoker);
+        return std::make_pair(reinterpret_cast<K *>(data_), reinterpret_cast<V *>(data_ + keys));
+    }
+
+private:
+    char *data_;
+    size_t capacity_;
+};
+
+}}
+
+#endif //SAL_WORKSPACE_HPP